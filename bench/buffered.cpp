@@ -0,0 +1,59 @@
+#include "art.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// uniformly random inserts straight into the tree and through write
+// buffers of growing capacity, followed by lookups of every key
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+std::vector<std::string> randomKeys(int count) {
+  std::mt19937_64 gen(42);
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    keys.push_back(std::to_string(gen() % 10000000000000000000ull));
+  }
+  return keys;
+}
+
+template <class Tree>
+void run(const char *name, Tree &tree, const std::vector<std::string> &keys) {
+  auto start = Clock::now();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    tree.insert(keys[i].c_str(), static_cast<int>(i));
+  }
+  double insert = since(start);
+  int value = 0;
+  start = Clock::now();
+  for (auto &key : keys) {
+    tree.search(key.c_str(), value);
+  }
+  std::printf("%-12s %10.1f %10.1f\n", name, insert, since(start));
+}
+
+} // namespace
+
+int main() {
+  auto keys = randomKeys(2000000);
+  std::printf("%-12s %10s %10s\n", "buffer (ms)", "insert", "lookup");
+  {
+    art::AdaptiveRadixTree<int> tree;
+    run("none", tree, keys);
+  }
+  for (size_t capacity : {64, 256, 1024, 4096, 16384}) {
+    art::BufferedAdaptiveRadixTree<int> tree{capacity};
+    run(std::to_string(capacity).c_str(), tree, keys);
+  }
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "art.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// insert and remove workloads that keep nodes near their size limits
+// run against each node policy
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// key of the given child under the given parent node
+std::string makeKey(int parent, int child) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "p%06d", parent);
+  std::string key{buf};
+  key += static_cast<char>(child + 1);
+  return key;
+}
+
+/**
+    @brief Fill parents to size children, then add and remove one
+      more child of every parent, rounds times
+ */
+template <class Tree> double boundary(int parents, int size, int rounds) {
+  Tree tree;
+  for (int p = 0; p < parents; ++p) {
+    for (int c = 0; c < size; ++c) {
+      tree.insert(makeKey(p, c).c_str(), c);
+    }
+  }
+  std::vector<std::string> extra;
+  for (int p = 0; p < parents; ++p) {
+    extra.push_back(makeKey(p, size));
+  }
+  int value = 0;
+  auto start = Clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    for (auto &key : extra) {
+      tree.insert(key.c_str(), r);
+    }
+    for (auto &key : extra) {
+      tree.remove(key.c_str(), value);
+    }
+  }
+  return since(start);
+}
+
+/**
+    @brief Random inserts and removes over a fixed key space,
+      followed by lookups of every key
+ */
+template <class Tree> std::pair<double, double> random(int ops) {
+  Tree tree;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> parent(0, 9999);
+  std::uniform_int_distribution<int> child(0, 63);
+  int value = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < ops; ++i) {
+    std::string key = makeKey(parent(gen), child(gen));
+    if (gen() % 2 == 0) {
+      tree.insert(key.c_str(), i);
+    } else {
+      tree.remove(key.c_str(), value);
+    }
+  }
+  double churn = since(start);
+  start = Clock::now();
+  for (int p = 0; p < 10000; ++p) {
+    for (int c = 0; c < 64; ++c) {
+      tree.search(makeKey(p, c).c_str(), value);
+    }
+  }
+  return {churn, since(start)};
+}
+
+template <class Policy> void run(const char *name) {
+  using Tree = art::AdaptiveRadixTree<int, Policy>;
+  std::printf("%-12s", name);
+  // one past the capacity of Node4, Node16 and Node48
+  for (int size : {4, 16, 48}) {
+    std::printf(" %10.1f", boundary<Tree>(20000, size, 20));
+  }
+  auto [churn, lookup] = random<Tree>(4000000);
+  std::printf(" %10.1f %10.1f\n", churn, lookup);
+}
+
+} // namespace
+
+int main() {
+  std::printf("%-12s %10s %10s %10s %10s %10s\n", "policy (ms)", "4<->5",
+              "16<->17", "48<->49", "random", "lookup");
+  run<art::DefaultNodePolicy>("default");
+  run<art::HysteresisNodePolicy>("hysteresis");
+  run<art::FineNodePolicy>("fine");
+  return 0;
+}
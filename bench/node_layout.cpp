@@ -0,0 +1,78 @@
+#include "art.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// cache lines read and time taken per lookup, for the node layouts
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// sparse random keys end in small nodes, dense decimal ones in wide
+std::vector<std::string> makeKeys(size_t n, bool dense) {
+  std::mt19937_64 gen(42);
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  char buf[24];
+  for (size_t i = 0; i < n; ++i) {
+    if (dense) {
+      std::snprintf(buf, sizeof(buf), "%012zu", i * 7);
+    } else {
+      std::snprintf(buf, sizeof(buf), "%016llx",
+                    static_cast<unsigned long long>(gen()));
+    }
+    keys.emplace_back(buf);
+  }
+  return keys;
+}
+
+template <class Policy>
+void run(const char *name, const std::vector<std::string> &keys,
+         size_t lookups) {
+  art::AdaptiveRadixTree<uint64_t, Policy> tree;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    tree.insert(keys[i].c_str(), i);
+  }
+  std::mt19937_64 gen(7);
+  std::vector<const char *> order(lookups);
+  for (auto &key : order) {
+    key = keys[gen() % keys.size()].c_str();
+  }
+  uint64_t value = 0, sum = 0;
+  auto start = Clock::now();
+  for (const char *key : order) {
+    tree.search(key, value);
+    sum += value;
+  }
+  double ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  size_t lines = 0;
+  for (const char *key : order) {
+    lines += tree.cacheLines(key);
+  }
+  std::printf("%-20s %12.1f %12.2f %20llu\n", name, ns / lookups,
+              static_cast<double>(lines) / lookups,
+              static_cast<unsigned long long>(sum));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+  size_t lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+  std::printf("%zu keys, %zu random lookups\n", n, lookups);
+  std::printf("%-20s %12s %12s %20s\n", "keys", "ns/lookup", "lines/lookup",
+              "checksum");
+  for (bool dense : {false, true}) {
+    auto keys = makeKeys(n, dense);
+    run<art::DefaultNodePolicy>(dense ? "dense" : "sparse", keys, lookups);
+    run<art::FineNodePolicy>(dense ? "dense, fine" : "sparse, fine", keys,
+                             lookups);
+  }
+  return 0;
+}
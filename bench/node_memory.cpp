@@ -0,0 +1,153 @@
+#include "art.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// random lookups in a large tree with nodes from the default heap
+// and from huge page arenas, with dTLB misses where perf allows
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+    @brief dTLB load misses of the calling thread, unavailable in
+      containers and VMs without perf access
+ */
+class TlbMisses {
+public:
+  TlbMisses() {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+  ~TlbMisses() {
+#ifdef __linux__
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+#endif
+  }
+
+  bool available() const { return fd_ >= 0; }
+
+  void start() {
+#ifdef __linux__
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t stop() {
+    uint64_t count = 0;
+#ifdef __linux__
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+#endif
+    return count;
+  }
+
+private:
+  int fd_ = -1;
+};
+
+std::vector<std::string> makeKeys(size_t n) {
+  std::mt19937_64 gen(42);
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  char buf[24];
+  for (size_t i = 0; i < n; ++i) {
+    std::snprintf(buf, sizeof(buf), "%016llx",
+                  static_cast<unsigned long long>(gen()));
+    keys.emplace_back(buf);
+  }
+  return keys;
+}
+
+void run(const char *name, const std::vector<std::string> &keys,
+         size_t lookups) {
+  art::AdaptiveRadixTree<uint64_t> tree;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    tree.insert(keys[i].c_str(), i);
+  }
+  std::mt19937_64 gen(7);
+  std::vector<const char *> order(lookups);
+  for (auto &key : order) {
+    key = keys[gen() % keys.size()].c_str();
+  }
+  TlbMisses misses;
+  uint64_t value = 0, sum = 0;
+  misses.start();
+  auto start = Clock::now();
+  for (const char *key : order) {
+    tree.search(key, value);
+    sum += value;
+  }
+  double ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  uint64_t count = misses.stop();
+  std::printf("%-24s %12.1f", name, ns / lookups);
+  if (misses.available()) {
+    std::printf(" %12.3f", static_cast<double>(count) / lookups);
+  } else {
+    std::printf(" %12s", "n/a");
+  }
+  // keep the lookups from being optimized away
+  std::printf(" %20llu\n", static_cast<unsigned long long>(sum));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+  size_t lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+  auto keys = makeKeys(n);
+  std::printf("%zu keys, %zu random lookups\n", n, lookups);
+  std::printf("%-24s %12s %12s %20s\n", "memory", "ns/lookup",
+              "dTLB/lookup", "checksum");
+  run("default heap", keys, lookups);
+
+  art::NodeMemoryOptions options;
+  options.hugePages = art::HugePages::NONE;
+  art::useNodeMemory(options);
+  run("arena", keys, lookups);
+
+  options.hugePages = art::HugePages::TRANSPARENT;
+  art::useNodeMemory(options);
+  run("arena, huge pages", keys, lookups);
+
+  options.numaLocal = true;
+  options.interleaveUpper = true;
+  art::useNodeMemory(options);
+  run("arena, huge pages, numa", keys, lookups);
+  art::useDefaultNodeMemory();
+  return 0;
+}
@@ -2,12 +2,29 @@
 #define ART_HPP
 
 #include "art/art.hpp"
+#include "art/art_automaton.hpp"
+#include "art/art_buffered.hpp"
+#include "art/art_columns.hpp"
+#include "art/art_compare.hpp"
+#include "art/art_cursor.hpp"
 #include "art/art_inner_node.hpp"
+#include "art/art_iterator.hpp"
 #include "art/art_leaf_node.hpp"
+#include "art/art_logged.hpp"
+#include "art/art_merge_iterator.hpp"
 #include "art/art_node.hpp"
 #include "art/art_node16.hpp"
 #include "art/art_node256.hpp"
+#include "art/art_node32.hpp"
 #include "art/art_node48.hpp"
 #include "art/art_node4.hpp"
+#include "art/art_node8.hpp"
+#include "art/art_node_memory.hpp"
+#include "art/art_node_policy.hpp"
+#include "art/art_parallel.hpp"
+#include "art/art_partitioned.hpp"
+#include "art/art_ring.hpp"
+#include "art/art_stats.hpp"
+#include "art/art_value_log.hpp"
 
 #endif
\ No newline at end of file
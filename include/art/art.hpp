@@ -1,8 +1,20 @@
 #ifndef ART_IMPL_H
 #define ART_IMPL_H
 
+#include "art_cursor.hpp"
 #include "art_inner_node.hpp"
+#include "art_iterator.hpp"
 #include "art_leaf_node.hpp"
+#include "art_node_policy.hpp"
+#include "art_parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace art {
 
@@ -10,6 +22,18 @@ enum class RC {
   SUCCESS,
   INTERNAL_FAILURE,
   KEY_NOT_EXIST,
+  // a call with a time budget stopped before it was done
+  IN_PROGRESS,
+  // nodes come from the default heap, see useNodeMemory
+  NO_NODE_MEMORY,
+};
+
+// order in which compact lays out the nodes
+enum class CompactOrder {
+  // parents before children, children by index key
+  DEPTH_FIRST,
+  // parents before children, children hottest subtree first
+  HOT_FIRST,
 };
 
 template <class T> class AdaptiveRadixTreePrinter;
@@ -18,89 +42,803 @@ template <class T> class Node16;
 template <class T> class Node48;
 template <class T> class Node256;
 
-template <class T> class AdaptiveRadixTree {
+/**
+    @brief Adaptive Radix Tree mapping C strings to values
+    @tparam T the value type, void for a set whose leaves only hold
+      the key, see contains, insert(key) and erase, Counted<T> to
+      keep leaf counts for rank, select, countRange and size
+    @tparam NodePolicy picks the inner node types and the thresholds
+      to grow and shrink them, see art_node_policy.hpp
+ */
+template <class T, class NodePolicy = DefaultNodePolicy>
+class AdaptiveRadixTree {
   friend class AdaptiveRadixTreePrinter<T>;
+  static_assert(isValidNodePolicy<NodePolicy>(), "invalid node policy");
 
 public:
   AdaptiveRadixTree() { root_ = nullptr; }
+  AdaptiveRadixTree(const AdaptiveRadixTree<T, NodePolicy> &) = delete;
+  AdaptiveRadixTree(AdaptiveRadixTree<T, NodePolicy> &&other)
+      : root_(other.root_), tombstones_(other.tombstones_),
+        tombstoneKeys_(std::move(other.tombstoneKeys_)),
+        bytes_(other.bytes_), reclaimer_(std::move(other.reclaimer_)) {
+    other.root_ = nullptr;
+    other.appendPath_.clear();
+    other.compactPath_.clear();
+    other.tombstones_ = 0;
+    other.tombstoneKeys_.clear();
+    other.bytes_ = 0;
+  }
+  AdaptiveRadixTree<T, NodePolicy> &
+  operator=(const AdaptiveRadixTree<T, NodePolicy> &) = delete;
+  AdaptiveRadixTree<T, NodePolicy> &
+  operator=(AdaptiveRadixTree<T, NodePolicy> &&other) {
+    std::swap(root_, other.root_);
+    std::swap(tombstones_, other.tombstones_);
+    std::swap(tombstoneKeys_, other.tombstoneKeys_);
+    std::swap(bytes_, other.bytes_);
+    // a subtree being freed doesn't depend on the tree it came from
+    std::swap(reclaimer_, other.reclaimer_);
+    appendPath_.clear();
+    other.appendPath_.clear();
+    compactPath_.clear();
+    other.compactPath_.clear();
+    // the budgets stay with the tree objects
+    rebudget();
+    other.rebudget();
+    return *this;
+  }
+  ~AdaptiveRadixTree() {
+    reclaim();
+    Node<T>::release(root_);
+  }
+
+  // the value type, NoValue for a set
+  using Value = ValueOf<T>;
+
+  // the inner nodes keep the number of leaves under them
+  static constexpr bool ORDER_STATISTICS = isCounted<T>;
 
   /**
     @brief Given key, try to get the corresponding value
     @param[out] val hold the value if key exists
   */
-  RC search(const char *key, T &value);
+  RC search(const char *key, Value &value);
+
+  // check if key exists
+  bool contains(const char *key) { return findLeaf(key) != nullptr; }
+
+  /**
+    @brief Find the longest stored key that is a prefix of key
+    @param[out] value hold the value of that key if exists
+  */
+  RC longestPrefixMatch(const char *key, Value &value);
 
   /**
     @brief Given a <Key, Value> pair, do insert
       if key already exists, do update
   */
-  RC insert(const char *key, const T &value);
+  RC insert(const char *key, const Value &value);
+
+  /**
+    @brief Insert or update as above
+    @param[out] added true if key was not in the tree, false if only
+      its value was updated
+  */
+  RC insert(const char *key, const Value &value, bool &added);
+
+  // insert key into a set, if key already exists, do nothing
+  RC insert(const char *key) {
+    static_assert(std::is_same_v<Value, NoValue>,
+                  "a map inserts a key with a value");
+    return insert(key, Value{});
+  }
+
+  /**
+    @brief Insert a batch of <Key, Value> pairs, each insert starts at
+      the deepest node still on the path of the previous key instead
+      of the root, the longer the common prefix of neighbouring keys
+      the less is visited, sorted batches benefit the most
+    @param[in] first/last range of pairs whose first is a std::string
+      or a const char *, existing keys are updated
+  */
+  template <class InputIt> RC insertSorted(InputIt first, InputIt last);
+
+  /**
+    @brief Insert a key larger than every key appended before, the
+      walk starts at the deepest node of the cached path of the last
+      appended key, while keys keep increasing a Node16 filling up on
+      that path grows straight to Node256,
+      any other write drops the cached path,
+      a key that is not larger is still inserted correctly
+  */
+  RC append(const char *key, const Value &value);
 
   /**
     @brief Given key, delete if exists
     @param[out] value hold the value if key exists
   */
-  RC remove(const char *key, T &value);
+  RC remove(const char *key, Value &value);
+
+  // Given key, delete if exists
+  RC erase(const char *key) {
+    Value value;
+    return remove(key, value);
+  }
+
+  /**
+    @brief Switch lazy removal on or off, a lazy remove only marks
+      the leaf as a tombstone, lookups and iteration skip tombstones
+      and purge unlinks them in bulk
+    @param[in] purgeThreshold purge after this many lazy removes,
+      0 to purge only on demand
+  */
+  void setLazyRemove(bool lazy, size_t purgeThreshold = 0);
+
+  /**
+    @brief Unlink all tombstones, only the paths to the lazily removed
+      keys are visited, in key order, so the cost follows the number
+      of tombstones rather than the size of the tree,
+      inner nodes on those paths shared with a snapshot are copied
+    @return the number of tombstones unlinked
+  */
+  size_t purge();
+
+  /**
+    @brief Bound the memory of the tree to use it as a cache, while
+      memoryUsage() exceeds the budget a CLOCK hand sweeping the keys
+      in order evicts the entries not searched since the hand last
+      passed them, an entry never searched is evicted the first time,
+      the sweep resumes where it stopped, every leaf keeps a
+      reference bit, no separate eviction list
+    @param[in] bytes the budget, 0 for unbounded
+  */
+  void setMemoryBudget(size_t bytes);
+
+  /**
+    @brief Bytes of all nodes, keys and prefixes of the tree, tracked
+      on every write while a budget is set, computed by a walk of
+      the whole tree otherwise
+  */
+  size_t memoryUsage();
+
+  /**
+    @brief Move the nodes to freshly allocated memory, every parent
+      right before its children, so that a walk down the tree touches
+      few pages, nodes shared with a snapshot stay where they are,
+      only the arenas of useNodeMemory hand out blocks in order,
+      the default heap places the copies wherever it likes
+    @param[in] budget return after about this long, the next call goes
+      on with the subtrees not moved yet, zero moves the whole tree
+    @param[in] order HOT_FIRST places the subtrees with the most leaves
+      searched since the CLOCK hand passed first, it needs a memory
+      budget for the leaves to be marked, DEPTH_FIRST is used otherwise
+    @return SUCCESS once all nodes are moved, the next call starts
+      over, IN_PROGRESS when the budget ran out first, NO_NODE_MEMORY
+      without arenas, nothing is moved then
+  */
+  RC compact(std::chrono::microseconds budget = {},
+             CompactOrder order = CompactOrder::DEPTH_FIRST);
+
+  /**
+    @brief Number of distinct cache lines search(key) reads: node
+      headers, prefixes, index keys, child pointers and the leaf,
+      to compare node layouts
+  */
+  size_t cacheLines(const char *key);
+
+  /**
+    @brief Move all keys of other into this tree, subtrees that
+      don't overlap are relinked instead of re-inserted
+    @param[in] policy called as policy(key, value, otherValue) when
+      both trees hold key, returns the value to keep
+  */
+  template <class Policy>
+  RC merge(AdaptiveRadixTree<T, NodePolicy> &&other, Policy policy);
+
+  /**
+    @brief Detach all keys starting with prefix into a new tree,
+      only the path to the matching subtree is visited
+  */
+  AdaptiveRadixTree<T, NodePolicy> extractPrefix(const char *prefix);
+
+  /**
+    @brief Delete all keys starting with prefix
+    @param[in] background free the detached subtree on a thread owned
+      by the tree, one subtree at a time, joined by the destructor
+  */
+  RC erasePrefix(const char *prefix, bool background = false);
+
+  /**
+    @brief Delete all keys in [lo, hi), only the paths to lo and hi
+      are visited, subtrees in between are freed as a whole
+    @param[in] lo inclusive lower bound, nullptr for no lower bound
+    @param[in] hi exclusive upper bound, nullptr for no upper bound
+    @return the number of erased keys
+  */
+  size_t eraseRange(const char *lo, const char *hi);
+
+  /**
+    @brief Number of keys less than key, O(depth * fanout),
+      rank, select, countRange and size need a tree of Counted values
+  */
+  size_t rank(const char *key);
+
+  /**
+    @brief Get the k-th smallest key, counting from 0, O(depth * fanout)
+    @param[out] key hold the key if exists
+    @param[out] value hold the value if exists
+  */
+  RC select(size_t k, std::string &key, Value &value);
+
+  /**
+    @brief Number of keys in [lo, hi), O(depth * fanout)
+    @param[in] lo inclusive lower bound, nullptr for no lower bound
+    @param[in] hi exclusive upper bound, nullptr for no upper bound
+  */
+  size_t countRange(const char *lo, const char *hi);
+
+  // number of keys
+  size_t size();
+
+  /**
+    @brief Visit in key order every key accepted by an automaton,
+      subtrees whose prefix or index key drive it into a dead state
+      are skipped, see art_automaton.hpp for the automaton interface
+    @param[in] fn called as fn(key, value) for each accepted key
+  */
+  template <class Automaton, class Fn>
+  void traverse(const Automaton &automaton, Fn fn);
+
+  /**
+    @brief Visit every key on several threads, the tree is split into
+      subtrees at the first inner nodes with enough fanout and the
+      subtrees are handed to a WorkStealingPool
+    @param[in] fn called as fn(key, value) concurrently from the
+      worker threads, keys in no particular order across subtrees
+    @param[in] threads 0 for one per hardware thread
+    @note the tree must not be written meanwhile, scan a snapshot to
+      keep writing
+  */
+  template <class Fn> void parallelForEach(Fn fn, unsigned threads = 0);
+
+  /**
+    @brief Visit every key in [lo, hi) on several threads, subtrees
+      outside the range are skipped, the ones straddling a bound are
+      split down to the leaves, see parallelForEach
+    @param[in] lo inclusive lower bound, nullptr for no lower bound
+    @param[in] hi exclusive upper bound, nullptr for no upper bound
+  */
+  template <class Fn>
+  void parallelScan(const char *lo, const char *hi, Fn fn,
+                    unsigned threads = 0);
+
+  /**
+    @brief Like parallelScan, but every subtree appends to an output
+      of its own and the outputs are concatenated in key order, so
+      the result is the same as that of a single threaded scan
+    @param[in] fn called as fn(out, key, value), out is an Out
+      supporting insert(end, first, last), e.g. a vector or a string
+  */
+  template <class Out, class Fn>
+  Out parallelCollect(const char *lo, const char *hi, Fn fn,
+                      unsigned threads = 0);
+
+  /**
+    @brief Get a point-in-time version of the tree in O(1),
+      both trees share all nodes, a write to either of them copies
+      the path from the root down to the nodes it modifies,
+      a node is freed once no version references it anymore
+    @note the snapshot may be read on other threads while this tree
+      keeps being written, taking it must not race with writes
+  */
+  AdaptiveRadixTree<T, NodePolicy> snapshot();
+
+  /**
+    @brief Get an iterator positioned at the smallest key,
+      keys are visited in lexicographic order
+  */
+  Iterator<T> begin() { return Iterator<T>{root_}; }
+
+  /**
+    @brief Get a cursor for runs of nearby lookups and ordered moves,
+      it is not positioned until the first seek
+  */
+  Cursor<T> cursor() { return Cursor<T>{root_}; }
 
 private:
+  // an inner node on the path of the last inserted key
+  struct PathFrame {
+    InnerNode<T> *node;
+    // depth of the node's prefix in the key
+    int depth;
+  };
+
+  /**
+    @brief Find the leaf of key
+    @param[in] tombstone look for a tombstone instead of a live leaf,
+      a live leaf found is marked as referenced
+    @return nullptr if none
+  */
+  LeafNode<T> *findLeaf(const char *key, bool tombstone = false);
+
+  static const char *keyData(const char *key) { return key; }
+  static const char *keyData(const std::string &key) { return key.c_str(); }
+
+  /**
+    @brief Drop the nodes of the path of lastKey that are not on
+      the path of key
+    @return the length of the common prefix of both keys
+  */
+  static size_t trimPath(std::vector<PathFrame> &path,
+                         const std::string &lastKey, const char *key);
+
+  /**
+    @brief insert, optionally resuming from and maintaining the path
+    @param[in,out] path root-to-node path to start from,
+      hold the path of key afterwards, nullptr to start at the root
+    @param[in] wide a full Node16 grows straight to Node256
+    @param[out] added set to whether key is new, if not nullptr
+  */
+  RC insert(const char *key, const Value &value,
+            std::vector<PathFrame> *path, bool wide = false,
+            bool *added = nullptr);
+
   Node<T> *findChild(Node<T> *node, char byte);
 
+  /**
+    @brief Make node private to this tree before modifying it,
+      a shared node is replaced by a copy
+    @return the node to modify, it takes over the reference on node
+  */
+  Node<T> *own(Node<T> *node);
+
+  // own node and relink it under parent, nullptr parent for the root
+  Node<T> *ownChild(Node<T> *parent, uint8_t byte, Node<T> *node);
+
+  // link node under parent in place of the old child, or make it the root
+  void relink(Node<T> *parent, uint8_t byte, Node<T> *node);
+
+  // replace a full inner node by the next type of the policy, with wide
+  // a Node16 is converted straight to Node256
+  InnerNode<T> *growNode(InnerNode<T> *inner, bool wide = false);
+
+  // replace an underfull inner node by the previous type of the policy,
+  // a Node4 left with one child is merged into it
+  Node<T> *shrinkNode(InnerNode<T> *inner);
+
+  // too few children for the node type under the policy
+  static bool isUnderfull(const InnerNode<T> *inner);
+
+  // bytes allocated for node itself, its key or prefix included
+  static size_t nodeBytes(const Node<T> *node);
+
+  // bytes allocated for the subtree of node
+  static size_t countBytes(const Node<T> *node);
+
+  bool overBudget() const { return budget_ != 0 && bytes_ > budget_; }
+
+  // move the CLOCK hand until the tree is back within budget
+  void evict();
+
+  // recount the bytes after a bulk change and evict if needed
+  void rebudget();
+
+  // wait until the last background erasePrefix has freed its subtree
+  void reclaim() {
+    if (reclaimer_.joinable()) {
+      reclaimer_.join();
+    }
+  }
+
+  // a copy of an unshared node in new memory, node is freed
+  static Node<T> *relocate(Node<T> *node);
+
+  // index keys of the children of inner in the order compact visits them
+  static std::vector<uint8_t> layoutOrder(InnerNode<T> *inner, bool hot);
+
+  // referenced leaves among the first scan leaves of the subtree
+  static size_t countReferenced(Node<T> *node, size_t &scan);
+
+  /**
+    @brief Merge two subtrees both found at depth
+    @param[in] swapped true if node comes from the other tree
+    @return the root of the merged subtree
+  */
+  template <class Policy>
+  Node<T> *mergeNode(Node<T> *node, Node<T> *other, int depth,
+                     Policy &policy, bool swapped);
+
+  /**
+    @brief Erase keys in [lo, hi) from the subtree found at depth,
+      every node is fixed up once after all its children are handled
+    @param[in] loBound/hiBound false if the subtree is known to be
+      above lo/below hi
+    @param[out] erased add the number of erased keys
+    @return the root of the remaining subtree, nullptr if empty
+  */
+  Node<T> *eraseRange(Node<T> *node, int depth, const char *lo, bool loBound,
+                      const char *hi, bool hiBound, size_t &erased);
+
+  // count a lazily removed key and list it for the next purge
+  void addTombstone(const char *key);
+
+  // unlink all tombstones without evicting
+  size_t dropTombstones();
+
+  /**
+    @brief Shrink an inner node that may have lost several children
+    @return the node taking its place, nullptr if no child is left
+  */
+  Node<T> *shrinkToFit(InnerNode<T> *inner);
+
+  // feed the subtree found at depth to the automaton in state
+  template <class Automaton, class Fn>
+  void traverse(Node<T> *node, int depth, typename Automaton::State state,
+                const Automaton &automaton, Fn &fn);
+
+  // subtrees per thread handed to the pool, the more the better the
+  // balance across threads and the more splitting
+  static constexpr size_t PARALLEL_TASKS = 16;
+
+  /**
+    @brief Collect in key order the subtrees under node with keys in
+      [lo, hi) only, leaves are checked one by one
+    @param[in,out] path the bytes leading to node
+  */
+  void rangeSubtrees(Node<T> *node, std::string &path, const char *lo,
+                     const char *hi, std::vector<Node<T> *> &subtrees);
+
+  /**
+    @brief Split [lo, hi) into subtrees in key order, inner nodes are
+      replaced by their children level by level until there are about
+      PARALLEL_TASKS per thread
+  */
+  std::vector<Node<T> *> partition(const char *lo, const char *hi,
+                                   unsigned threads);
+
+  // number of live leaves under node, O(1) in a tree of Counted values
+  size_t countLeaves(Node<T> *node);
+
+  // recompute the leaf count of an inner node from its children
+  void recount(InnerNode<T> *node);
+
+  /**
+    @brief Add delta to the leaf count of every inner node
+      on the path of key whose prefix matches
+  */
+  void addPathCount(const char *key, long long delta);
+
   Node<T> *root_;
+  // path and key of the last append, valid until any other write
+  std::vector<PathFrame> appendPath_;
+  std::string appendKey_;
+  bool lazyRemove_ = false;
+  size_t purgeThreshold_ = 0;
+  // tombstones in the tree, an upper bound once a bulk erase or merge
+  // dropped some
+  size_t tombstones_ = 0;
+  // keys removed lazily since the last purge, some may have been
+  // inserted or erased again since
+  std::vector<std::string> tombstoneKeys_;
+  // memory budget, 0 for unbounded
+  size_t budget_ = 0;
+  // bytes reachable from root_, see memoryUsage
+  size_t bytes_ = 0;
+  // the CLOCK hand, the next key to examine is the smallest >= it
+  std::string clockHand_;
+  // frees the subtree of the last background erasePrefix
+  std::thread reclaimer_;
+
+  // an inner node moved by compact and its children left to move
+  struct CompactFrame {
+    InnerNode<T> *node;
+    // index keys of the children in the order they are moved
+    std::vector<uint8_t> order;
+    // position in order of the next child, the one before it is the
+    // child the next frame belongs to
+    size_t next;
+  };
+  // root-to-node path of an unfinished compact
+  std::vector<CompactFrame> compactPath_;
 };
 
-template <class T> RC AdaptiveRadixTree<T>::search(const char *key, T &val) {
-  if (root_ == nullptr) {
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::search(const char *key, Value &val) {
+  LeafNode<T> *leaf = findLeaf(key);
+  if (leaf == nullptr) {
     return RC::KEY_NOT_EXIST;
   }
+  val = leaf->getValue();
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+LeafNode<T> *AdaptiveRadixTree<T, NodePolicy>::findLeaf(const char *key,
+                                                       bool tombstone) {
+  if (root_ == nullptr) {
+    return nullptr;
+  }
+  countStat(Counter::SEARCHES);
   size_t keyLen = std::strlen(key);
   Node<T> *cur = this->root_;
   int depth = 0;
   while (cur->type() != NodeType::LeafNode) {
+    countStat(Counter::SEARCH_NODES);
     // first check prefix match
     int len = cur->getPrefixLen();
     if (cur->checkPrefix(key, keyLen, depth) != len) {
-      return RC::KEY_NOT_EXIST;
+      return nullptr;
     }
     depth += len;
     cur = findChild(cur, key[depth]);
     if (cur == nullptr) {
-      return RC::KEY_NOT_EXIST;
+      return nullptr;
     }
     depth++;
   }
-  if (static_cast<LeafNode<T> *>(cur)->checkKeyMatch(key, keyLen)) {
-    val = static_cast<LeafNode<T> *>(cur)->getValue();
-    return RC::SUCCESS;
+  countStat(Counter::SEARCH_NODES);
+  auto leaf = static_cast<LeafNode<T> *>(cur);
+  if (leaf->checkKeyMatch(key, keyLen, depth) &&
+      leaf->isTombstone() == tombstone) {
+    if (budget_ != 0 && !tombstone) {
+      leaf->setReferenced(true);
+    }
+    return leaf;
   }
-  return RC::KEY_NOT_EXIST;
+  return nullptr;
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::longestPrefixMatch(const char *key,
+                                                     Value &value) {
+  int keyLen = std::strlen(key);
+  LeafNode<T> *best = nullptr;
+  Node<T> *cur = root_;
+  int depth = 0;
+  while (cur != nullptr) {
+    if (cur->type() == NodeType::LeafNode) {
+      int len = cur->getPrefixLen();
+      if (len <= keyLen && cur->checkPrefix(key, keyLen, depth) == len - depth &&
+          !static_cast<LeafNode<T> *>(cur)->isTombstone()) {
+        best = static_cast<LeafNode<T> *>(cur);
+      }
+      break;
+    }
+    int len = cur->getPrefixLen();
+    if (cur->checkPrefix(key, keyLen, depth) != len) {
+      break;
+    }
+    depth += len;
+    // a key ending right here is stored under the '\0' index key
+    Node<T> *term = findChild(cur, '\0');
+    if (term != nullptr && !static_cast<LeafNode<T> *>(term)->isTombstone()) {
+      best = static_cast<LeafNode<T> *>(term);
+    }
+    if (depth >= keyLen) {
+      break;
+    }
+    cur = findChild(cur, key[depth]);
+    depth++;
+  }
+  if (best == nullptr) {
+    return RC::KEY_NOT_EXIST;
+  }
+  value = best->getValue();
+  return RC::SUCCESS;
 }
 
-template <class T>
-Node<T> *AdaptiveRadixTree<T>::findChild(Node<T> *node, char byte) {
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::findChild(Node<T> *node,
+                                                     char byte) {
   switch (node->type()) {
   case NodeType::Node4:
     return static_cast<Node4<T> *>(node)->findChild(static_cast<uint8_t>(byte));
+  case NodeType::Node8:
+    return static_cast<Node8<T> *>(node)->findChild(static_cast<uint8_t>(byte));
   case NodeType::Node16:
     return static_cast<Node16<T> *>(node)->findChild(
         static_cast<uint8_t>(byte));
+  case NodeType::Node32:
+    return static_cast<Node32<T> *>(node)->findChild(
+        static_cast<uint8_t>(byte));
   case NodeType::Node48:
     return static_cast<Node48<T> *>(node)->findChild(
         static_cast<uint8_t>(byte));
   case NodeType::Node256:
-    return static_cast<Node48<T> *>(node)->findChild(
+    return static_cast<Node256<T> *>(node)->findChild(
         static_cast<uint8_t>(byte));
   default:
     return nullptr;
   }
 }
 
-template <class T>
-RC AdaptiveRadixTree<T>::insert(const char *key, const T &value) {
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::own(Node<T> *node) {
+  if (!node->isShared()) {
+    return node;
+  }
+  Node<T> *copy = nullptr;
+  if (node->type() == NodeType::LeafNode) {
+    copy = new LeafNode<T>{node->getPrefix(),
+                           static_cast<LeafNode<T> *>(node)->getValue()};
+    countStat(Counter::LEAF_ALLOCS);
+  } else {
+    copy = static_cast<InnerNode<T> *>(node)->clone();
+  }
+  Node<T>::release(node);
+  return copy;
+}
+
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::ownChild(Node<T> *parent,
+                                                    uint8_t byte,
+                                                    Node<T> *node) {
+  Node<T> *owned = own(node);
+  if (owned != node) {
+    relink(parent, byte, owned);
+  }
+  return owned;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::relink(Node<T> *parent, uint8_t byte,
+                                              Node<T> *node) {
+  if (parent != nullptr) {
+    static_cast<InnerNode<T> *>(parent)->addChild(byte, node);
+  } else {
+    root_ = node;
+  }
+}
+
+template <class T, class NodePolicy>
+InnerNode<T> *AdaptiveRadixTree<T, NodePolicy>::growNode(InnerNode<T> *inner,
+                                                         bool wide) {
+  NodeType type = inner->type();
+  bytes_ -= nodeBytes(inner);
+  if (wide && type == NodeType::Node16) {
+    // every policy ends with Node256, skip the types in between
+    inner = convertNode(inner, NodeType::Node256);
+  } else if (NodePolicy::grown(type) == DefaultNodePolicy::grown(type)) {
+    // the node's own grow copies without searching
+    inner = inner->grow();
+  } else {
+    inner = convertNode(inner, NodePolicy::grown(type));
+  }
+  bytes_ += nodeBytes(inner);
+  return inner;
+}
+
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::shrinkNode(InnerNode<T> *inner) {
+  NodeType type = inner->type();
+  bytes_ -= nodeBytes(inner);
+  Node<T> *node = nullptr;
+  if (type == NodeType::Node4) {
+    // the only child takes over the prefix of the node
+    int byte = 0;
+    bytes_ -= nodeBytes(inner->nextChild(byte));
+    node = inner->shrink();
+  } else if (NodePolicy::shrunk(type) == DefaultNodePolicy::shrunk(type)) {
+    node = inner->shrink();
+  } else {
+    node = convertNode(inner, NodePolicy::shrunk(type));
+  }
+  bytes_ += nodeBytes(node);
+  return node;
+}
+
+template <class T, class NodePolicy>
+bool AdaptiveRadixTree<T, NodePolicy>::isUnderfull(const InnerNode<T> *inner) {
+  return inner->getSize() < NodePolicy::shrinkBelow(inner->type());
+}
+
+template <class T, class NodePolicy>
+AdaptiveRadixTree<T, NodePolicy> AdaptiveRadixTree<T, NodePolicy>::snapshot() {
+  // the cached nodes become shared and must be copied before writing
+  appendPath_.clear();
+  AdaptiveRadixTree<T, NodePolicy> version;
+  if (root_ != nullptr) {
+    root_->retain();
+    version.root_ = root_;
+    version.tombstones_ = tombstones_;
+    version.tombstoneKeys_ = tombstoneKeys_;
+  }
+  return version;
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::insert(const char *key,
+                                            const Value &value) {
+  bool added = false;
+  return insert(key, value, added);
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::insert(const char *key,
+                                            const Value &value, bool &added) {
+  appendPath_.clear();
+  RC rc = insert(key, value, nullptr, false, &added);
+  if (overBudget()) {
+    evict();
+  }
+  return rc;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::trimPath(std::vector<PathFrame> &path,
+                                                  const std::string &lastKey,
+                                                  const char *key) {
+  // nodes reached through the bytes shared with the last key
+  // are still on the path of this key
+  size_t common = 0;
+  while (common < lastKey.size() && lastKey[common] == key[common]) {
+    common++;
+  }
+  while (!path.empty() && static_cast<size_t>(path.back().depth) > common) {
+    path.pop_back();
+  }
+  return common;
+}
+
+template <class T, class NodePolicy>
+template <class InputIt>
+RC AdaptiveRadixTree<T, NodePolicy>::insertSorted(InputIt first, InputIt last) {
+  appendPath_.clear();
+  std::vector<PathFrame> path;
+  std::string lastKey;
+  for (; first != last; ++first) {
+    const char *key = keyData(first->first);
+    trimPath(path, lastKey, key);
+    insert(key, first->second, &path);
+    lastKey = key;
+    if (overBudget()) {
+      // evicting may free nodes of the path
+      evict();
+      path.clear();
+    }
+  }
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::append(const char *key,
+                                            const Value &value) {
+  if (appendPath_.empty()) {
+    appendKey_.clear();
+  }
+  size_t common = trimPath(appendPath_, appendKey_, key);
+  // the first differing byte tells if keys are still increasing
+  bool increasing =
+      common < appendKey_.size()
+          ? static_cast<uint8_t>(key[common]) >
+                static_cast<uint8_t>(appendKey_[common])
+          : key[common] != '\0';
+  insert(key, value, &appendPath_, increasing);
+  appendKey_ = key;
+  if (overBudget()) {
+    // drops the cached path
+    evict();
+  }
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::insert(const char *key,
+                                            const Value &value,
+                                            std::vector<PathFrame> *path,
+                                            bool wide, bool *added) {
+  countStat(Counter::INSERTS);
+  if (added != nullptr) {
+    *added = true;
+  }
   // create leaf node
   auto leafNode = new LeafNode<T>{key, value};
+  countStat(Counter::LEAF_ALLOCS);
   // Cond1: root is empty
   if (root_ == nullptr) {
     root_ = leafNode;
+    bytes_ += nodeBytes(leafNode);
     return RC::SUCCESS;
   }
 
@@ -109,8 +847,26 @@ RC AdaptiveRadixTree<T>::insert(const char *key, const T &value) {
   Node<T> *prev = nullptr;
   uint8_t prevKey = 0;
   Node<T> *cur = root_;
+  if (path != nullptr && !path->empty()) {
+    // resume at the deepest node kept, the loop pushes it again
+    cur = path->back().node;
+    depth = path->back().depth;
+    path->pop_back();
+    if (!path->empty()) {
+      prev = path->back().node;
+      prevKey = static_cast<uint8_t>(key[depth - 1]);
+    }
+  }
 
   while (cur != nullptr) {
+    countStat(Counter::INSERT_NODES);
+    if (cur->type() != NodeType::LeafNode) {
+      // copy the path shared with other versions on the way down
+      cur = ownChild(prev, prevKey, cur);
+      if (path != nullptr) {
+        path->push_back({static_cast<InnerNode<T> *>(cur), depth});
+      }
+    }
     int len = cur->getPrefixLen();
     int matchLen = cur->checkPrefix(key, keyLen, depth);
     if (cur->type() == NodeType::LeafNode) {
@@ -118,20 +874,67 @@ RC AdaptiveRadixTree<T>::insert(const char *key, const T &value) {
       len -= depth;
     }
 
+    // Cond3: key already exists, update value
+    if (cur->type() == NodeType::LeafNode &&
+        static_cast<LeafNode<T> *>(cur)->checkKeyMatch(key, keyLen, depth)) {
+      auto leaf = static_cast<LeafNode<T> *>(cur);
+      if (added != nullptr) {
+        *added = leaf->isTombstone();
+      }
+      if (leaf->isTombstone()) {
+        // a lazily removed key comes back
+        tombstones_--;
+        if constexpr (ORDER_STATISTICS) {
+          addPathCount(key, 1);
+        }
+      }
+      if (cur->isShared()) {
+        // other versions keep the old leaf
+        if (prev != nullptr) {
+          static_cast<InnerNode<T> *>(prev)->addChild(prevKey, leafNode);
+        } else {
+          root_ = leafNode;
+        }
+        Node<T>::release(cur);
+        return RC::SUCCESS;
+      }
+      leaf->setValue(value);
+      leaf->setTombstone(false);
+      delete leafNode;
+      return RC::SUCCESS;
+    }
+
     // Cond2: prefix mismatch
-    if (matchLen != len ||
-        (cur->type() == NodeType::LeafNode && matchLen != keyLen - depth)) {
+    if (matchLen != len || cur->type() == NodeType::LeafNode) {
+      countStat(Counter::PREFIX_SPLITS);
       // create new internal node that holds common prefix
       char *newPrefix = new char[matchLen + 1];
       std::copy(key + depth, key + depth + matchLen, newPrefix);
       newPrefix[matchLen] = '\0';
       auto innerNode = new Node4<T>{newPrefix};
+      if constexpr (ORDER_STATISTICS) {
+        if (path != nullptr) {
+          // all but a mismatching inner cur are ancestors of the key
+          size_t n = path->size();
+          n -= cur->type() != NodeType::LeafNode ? 1 : 0;
+          for (size_t i = 0; i < n; ++i) {
+            (*path)[i].node->addCount(1);
+          }
+        } else {
+          addPathCount(key, 1);
+        }
+        innerNode->setCount(countLeaves(cur) + 1);
+      }
       // get the first unmatched key, use them as index keys
       auto newLeafKey = static_cast<uint8_t>(key[depth + matchLen]);
-      auto curNodeKey = static_cast<uint8_t>(cur->getPrefix()[matchLen]);
+      uint8_t curNodeKey = 0;
       // truncate the prefix of the old inner node
+      bytes_ += nodeBytes(leafNode) + nodeBytes(innerNode);
       if (cur->type() != NodeType::LeafNode) {
+        curNodeKey = static_cast<uint8_t>(cur->getPrefix()[matchLen]);
+        bytes_ -= nodeBytes(cur);
         static_cast<InnerNode<T> *>(cur)->truncPrefix(matchLen + 1);
+        bytes_ += nodeBytes(cur);
       } else {
         curNodeKey = static_cast<uint8_t>(cur->getPrefix()[matchLen + depth]);
       }
@@ -142,29 +945,42 @@ RC AdaptiveRadixTree<T>::insert(const char *key, const T &value) {
       } else if (cur == root_) {
         root_ = innerNode;
       }
+      if (path != nullptr) {
+        // innerNode takes the place of cur
+        if (cur->type() != NodeType::LeafNode) {
+          path->back().node = innerNode;
+        } else {
+          path->push_back({innerNode, depth});
+        }
+      }
       delete[] newPrefix;
       return RC::SUCCESS;
     }
 
-    // Cond3: key already exists, update value
-    if (cur->type() == NodeType::LeafNode) {
-      static_cast<LeafNode<T> *>(cur)->setValue(value);
-      return RC::SUCCESS;
-    }
-
     depth += matchLen;
     Node<T> *nxt = findChild(cur, key[depth]);
     // Cond4: Reach nullptr
     if (nxt == nullptr) {
-      if (static_cast<InnerNode<T> *>(cur)->isFull()) {
-        if (prev != nullptr) {
-          cur = static_cast<InnerNode<T> *>(prev)->growChild(prevKey);
+      if constexpr (ORDER_STATISTICS) {
+        if (path != nullptr) {
+          for (auto &frame : *path) {
+            frame.node->addCount(1);
+          }
         } else {
-          cur = static_cast<InnerNode<T> *>(cur)->grow();
-          root_ = cur;
+          addPathCount(key, 1);
+        }
+      }
+      if (static_cast<InnerNode<T> *>(cur)->isFull()) {
+        // a Node16 filled up by increasing keys likely fills the
+        // types in between as well
+        cur = growNode(static_cast<InnerNode<T> *>(cur), wide);
+        relink(prev, prevKey, cur);
+        if (path != nullptr) {
+          path->back().node = static_cast<InnerNode<T> *>(cur);
         }
       }
       static_cast<InnerNode<T> *>(cur)->addChild(key[depth], leafNode);
+      bytes_ += nodeBytes(leafNode);
       return RC::SUCCESS;
     }
     prevKey = static_cast<uint8_t>(key[depth]);
@@ -175,21 +991,35 @@ RC AdaptiveRadixTree<T>::insert(const char *key, const T &value) {
   return RC::SUCCESS;
 }
 
-template <class T> RC AdaptiveRadixTree<T>::remove(const char *key, T &value) {
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::remove(const char *key, Value &value) {
+  appendPath_.clear();
   if (root_ == nullptr) {
     return RC::KEY_NOT_EXIST;
   }
+  countStat(Counter::REMOVES);
 
   // root is leaf node
   if (root_->type() == NodeType::LeafNode) {
-    if (static_cast<LeafNode<T> *>(root_)->checkKeyMatch(key,
-                                                         std::strlen(key))) {
-      value = static_cast<LeafNode<T> *>(root_)->getValue();
-      delete root_;
+    countStat(Counter::REMOVE_NODES);
+    auto leaf = static_cast<LeafNode<T> *>(root_);
+    if (!leaf->checkKeyMatch(key, std::strlen(key)) ||
+        (leaf->isTombstone() && lazyRemove_)) {
+      return RC::KEY_NOT_EXIST;
+    }
+    bool live = !leaf->isTombstone();
+    value = leaf->getValue();
+    if (lazyRemove_) {
+      leaf = static_cast<LeafNode<T> *>(ownChild(nullptr, 0, leaf));
+      leaf->setTombstone(true);
+      addTombstone(key);
+    } else {
+      tombstones_ -= live ? 0 : 1;
+      bytes_ -= nodeBytes(root_);
+      Node<T>::release(root_);
       root_ = nullptr;
-      return RC::SUCCESS;
     }
-    return RC::KEY_NOT_EXIST;
+    return live ? RC::SUCCESS : RC::KEY_NOT_EXIST;
   }
 
   Node<T> *prev = nullptr;
@@ -198,6 +1028,9 @@ template <class T> RC AdaptiveRadixTree<T>::remove(const char *key, T &value) {
   size_t keyLen = std::strlen(key);
   int depth = 0;
   while (cur->type() != NodeType::LeafNode) {
+    countStat(Counter::REMOVE_NODES);
+    // copy the path shared with other versions on the way down
+    cur = ownChild(prev, prevKey, cur);
     int len = cur->getPrefixLen();
     if (cur->checkPrefix(key, keyLen, depth) != len) {
       return RC::KEY_NOT_EXIST;
@@ -208,21 +1041,45 @@ template <class T> RC AdaptiveRadixTree<T>::remove(const char *key, T &value) {
       return RC::KEY_NOT_EXIST;
     }
     if (nxt->type() == NodeType::LeafNode) {
-      if (static_cast<LeafNode<T> *>(nxt)->checkKeyMatch(key, keyLen)) {
-        // nxt is the node to be deleted
-        static_cast<InnerNode<T> *>(cur)->deleteChild(key[depth]);
-        // shrink node if necessary
-        if (static_cast<InnerNode<T> *>(cur)->isLack()) {
-          if (prev != nullptr) {
-            static_cast<InnerNode<T> *>(prev)->shrinkChild(prevKey);
-          } else {
-            cur = static_cast<InnerNode<T> *>(cur)->shrink();
-            root_ = cur;
+      countStat(Counter::REMOVE_NODES);
+      auto leaf = static_cast<LeafNode<T> *>(nxt);
+      if (leaf->checkKeyMatch(key, keyLen, depth + 1)) {
+        bool live = !leaf->isTombstone();
+        if (lazyRemove_) {
+          if (!live) {
+            return RC::KEY_NOT_EXIST;
           }
-        }
-        value = static_cast<LeafNode<T> *>(nxt)->getValue();
-        delete nxt;
-        return RC::SUCCESS;
+          value = leaf->getValue();
+          leaf = static_cast<LeafNode<T> *>(ownChild(cur, key[depth], leaf));
+          leaf->setTombstone(true);
+          if constexpr (ORDER_STATISTICS) {
+            addPathCount(key, -1);
+          }
+          addTombstone(key);
+          if (tombstones_ >= purgeThreshold_ && purgeThreshold_ != 0) {
+            purge();
+          }
+          return RC::SUCCESS;
+        }
+        // nxt is the node to be deleted, a tombstone left by an
+        // earlier lazy remove is unlinked but not reported
+        tombstones_ -= live ? 0 : 1;
+        if constexpr (ORDER_STATISTICS) {
+          if (live) {
+            addPathCount(key, -1);
+          }
+        }
+        static_cast<InnerNode<T> *>(cur)->deleteChild(key[depth]);
+        bytes_ -= nodeBytes(nxt);
+        // shrink node if necessary
+        if (isUnderfull(static_cast<InnerNode<T> *>(cur))) {
+          relink(prev, prevKey, shrinkNode(static_cast<InnerNode<T> *>(cur)));
+        }
+        if (live) {
+          value = leaf->getValue();
+        }
+        Node<T>::release(nxt);
+        return live ? RC::SUCCESS : RC::KEY_NOT_EXIST;
       }
       return RC::KEY_NOT_EXIST;
     }
@@ -234,6 +1091,1032 @@ template <class T> RC AdaptiveRadixTree<T>::remove(const char *key, T &value) {
   return RC::KEY_NOT_EXIST;
 }
 
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::setLazyRemove(bool lazy,
+                                                     size_t purgeThreshold) {
+  lazyRemove_ = lazy;
+  purgeThreshold_ = purgeThreshold;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::purge() {
+  size_t purged = dropTombstones();
+  evict();
+  return purged;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::addTombstone(const char *key) {
+  tombstones_++;
+  tombstoneKeys_.emplace_back(key);
+  if (tombstoneKeys_.size() > 2 * tombstones_ + 64) {
+    // most listed keys came back or were unlinked, keep the list in
+    // proportion to the tombstones
+    tombstoneKeys_.erase(
+        std::remove_if(tombstoneKeys_.begin(), tombstoneKeys_.end(),
+                       [this](const std::string &listed) {
+                         return findLeaf(listed.c_str(), true) == nullptr;
+                       }),
+        tombstoneKeys_.end());
+  }
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::dropTombstones() {
+  // neighbouring keys walk the same nodes one after another
+  std::sort(tombstoneKeys_.begin(), tombstoneKeys_.end());
+  tombstoneKeys_.erase(
+      std::unique(tombstoneKeys_.begin(), tombstoneKeys_.end()),
+      tombstoneKeys_.end());
+  bool lazy = lazyRemove_;
+  lazyRemove_ = false;
+  size_t purged = 0;
+  Value value;
+  for (const std::string &key : tombstoneKeys_) {
+    // only a key still dead is unlinked, the path is copied only then
+    if (findLeaf(key.c_str(), true) != nullptr) {
+      remove(key.c_str(), value);
+      purged++;
+    }
+  }
+  lazyRemove_ = lazy;
+  appendPath_.clear();
+  tombstoneKeys_.clear();
+  tombstones_ = 0;
+  return purged;
+}
+
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::shrinkToFit(InnerNode<T> *inner) {
+  // fix the node size once, Node4 with a single child is compressed
+  while (isUnderfull(inner)) {
+    if (inner->getSize() == 0) {
+      delete inner;
+      return nullptr;
+    }
+    if (inner->type() == NodeType::Node4) {
+      return shrinkNode(inner);
+    }
+    inner = static_cast<InnerNode<T> *>(shrinkNode(inner));
+  }
+  return inner;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::setMemoryBudget(size_t bytes) {
+  budget_ = bytes;
+  // the bytes are not tracked through bulk changes without a budget
+  rebudget();
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::memoryUsage() {
+  if (budget_ == 0) {
+    bytes_ = root_ == nullptr ? 0 : countBytes(root_);
+  }
+  return bytes_;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::nodeBytes(const Node<T> *node) {
+  size_t bytes = node->getPrefix() != nullptr ? node->getPrefixLen() + 1 : 0;
+  switch (node->type()) {
+  case NodeType::LeafNode:
+    return bytes + sizeof(LeafNode<T>);
+  case NodeType::Node4:
+    return bytes + sizeof(Node4<T>);
+  case NodeType::Node8:
+    return bytes + sizeof(Node8<T>);
+  case NodeType::Node16:
+    return bytes + sizeof(Node16<T>);
+  case NodeType::Node32:
+    return bytes + sizeof(Node32<T>);
+  case NodeType::Node48:
+    return bytes + sizeof(Node48<T>);
+  case NodeType::Node256:
+    return bytes + sizeof(Node256<T>);
+  default:
+    return bytes;
+  }
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::countBytes(const Node<T> *node) {
+  size_t bytes = nodeBytes(node);
+  if (node->type() != NodeType::LeafNode) {
+    auto inner = const_cast<InnerNode<T> *>(
+        static_cast<const InnerNode<T> *>(node));
+    int byte = 0;
+    for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+         ++byte, child = inner->nextChild(byte)) {
+      bytes += countBytes(child);
+    }
+  }
+  return bytes;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::evict() {
+  // evicted entries must free their memory right away
+  bool lazy = lazyRemove_;
+  lazyRemove_ = false;
+  Value value;
+  if (overBudget() && tombstones_ != 0) {
+    // the hand passes over tombstones, they go before any live entry
+    dropTombstones();
+  }
+  while (overBudget() && root_ != nullptr) {
+    Cursor<T> hand{root_};
+    hand.seek(clockHand_.c_str());
+    // give every referenced entry a second chance
+    while (hand.valid() && hand.leaf_->isReferenced()) {
+      hand.leaf_->setReferenced(false);
+      hand.next();
+    }
+    if (!hand.valid()) {
+      if (clockHand_.empty() && tombstones_ != 0) {
+        // the cursor skips tombstones, drop them so the next sweep
+        // cannot come up empty again
+        dropTombstones();
+        continue;
+      }
+      // wrap around to the smallest key, the sweep above cleared the
+      // referenced bits so the next one finds a live entry
+      clockHand_.clear();
+      continue;
+    }
+    clockHand_ = hand.getKey();
+    // the hand keeps the key, the next seek lands on its successor
+    remove(clockHand_.c_str(), value);
+  }
+  lazyRemove_ = lazy;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::rebudget() {
+  if (budget_ != 0) {
+    bytes_ = root_ == nullptr ? 0 : countBytes(root_);
+    evict();
+  }
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::compact(std::chrono::microseconds budget,
+                                             CompactOrder order) {
+  if (!usingNodeMemory()) {
+    compactPath_.clear();
+    return RC::NO_NODE_MEMORY;
+  }
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::now() + budget;
+  bool hot = order == CompactOrder::HOT_FIRST && budget_ != 0;
+  appendPath_.clear();
+  // keep the frames still on the tree, writes since the last call may
+  // have replaced or shared some of the nodes
+  size_t valid = 0;
+  for (; valid < compactPath_.size(); ++valid) {
+    Node<T> *expected = root_;
+    if (valid > 0) {
+      CompactFrame &parent = compactPath_[valid - 1];
+      expected = parent.node->findChild(parent.order[parent.next - 1]);
+    }
+    if (compactPath_[valid].node != expected || expected->isShared()) {
+      break;
+    }
+  }
+  if (valid < compactPath_.size()) {
+    compactPath_.resize(valid);
+    if (valid > 0) {
+      // move the new node in place of the replaced one as well
+      compactPath_.back().next--;
+    }
+  }
+
+  // lay the nodes out one after another instead of in freed blocks
+  FreshNodeScope fresh;
+  if (compactPath_.empty()) {
+    if (root_ == nullptr || root_->isShared()) {
+      return RC::SUCCESS;
+    }
+    root_ = relocate(root_);
+    if (root_->type() == NodeType::LeafNode) {
+      return RC::SUCCESS;
+    }
+    auto inner = static_cast<InnerNode<T> *>(root_);
+    compactPath_.push_back({inner, layoutOrder(inner, hot), 0});
+  }
+  size_t moved = 0;
+  while (!compactPath_.empty()) {
+    if (budget.count() != 0 && ++moved % 64 == 0 &&
+        Clock::now() >= deadline) {
+      return RC::IN_PROGRESS;
+    }
+    CompactFrame &frame = compactPath_.back();
+    if (frame.next == frame.order.size()) {
+      compactPath_.pop_back();
+      continue;
+    }
+    uint8_t byte = frame.order[frame.next++];
+    Node<T> *child = frame.node->findChild(byte);
+    if (child == nullptr || child->isShared()) {
+      continue;
+    }
+    child = relocate(child);
+    frame.node->addChild(byte, child);
+    if (child->type() != NodeType::LeafNode) {
+      auto inner = static_cast<InnerNode<T> *>(child);
+      compactPath_.push_back({inner, layoutOrder(inner, hot), 0});
+    }
+  }
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::cacheLines(const char *key) {
+  std::vector<uintptr_t> lines;
+  auto touch = [&lines](const void *addr, size_t len) {
+    auto begin = reinterpret_cast<uintptr_t>(addr);
+    for (uintptr_t line = begin / CACHE_LINE;
+         line <= (begin + len - 1) / CACHE_LINE; ++line) {
+      lines.push_back(line);
+    }
+  };
+  int keyLen = std::strlen(key);
+  int depth = 0;
+  Node<T> *cur = root_;
+  while (cur != nullptr) {
+    // vtable pointer, prefix, prefix length and node type
+    touch(cur, sizeof(Node<T>));
+    int len = cur->getPrefixLen();
+    if (len > 0) {
+      touch(cur->getPrefix(), len);
+    }
+    if (cur->type() == NodeType::LeafNode) {
+      touch(cur, sizeof(LeafNode<T>));
+      break;
+    }
+    if (cur->checkPrefix(key, keyLen, depth) != len) {
+      break;
+    }
+    depth += len;
+    auto span = static_cast<InnerNode<T> *>(cur)->lookupSpan(key[depth]);
+    if (span.keys != nullptr) {
+      touch(span.keys, span.keysLen);
+    }
+    if (span.slot == nullptr) {
+      break;
+    }
+    touch(span.slot, sizeof(Node<T> *));
+    cur = *static_cast<Node<T> *const *>(span.slot);
+    depth++;
+  }
+  std::sort(lines.begin(), lines.end());
+  return std::unique(lines.begin(), lines.end()) - lines.begin();
+}
+
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::relocate(Node<T> *node) {
+  Node<T> *copy = nullptr;
+  if (node->type() == NodeType::LeafNode) {
+    auto leaf = static_cast<LeafNode<T> *>(node);
+    auto moved = new LeafNode<T>{leaf->getPrefix(), leaf->getValue()};
+    countStat(Counter::LEAF_ALLOCS);
+    moved->setTombstone(leaf->isTombstone());
+    moved->setReferenced(leaf->isReferenced());
+    copy = moved;
+  } else {
+    // the copy takes a reference on every child, the release drops them
+    copy = static_cast<InnerNode<T> *>(node)->clone();
+  }
+  Node<T>::release(node);
+  return copy;
+}
+
+template <class T, class NodePolicy>
+std::vector<uint8_t>
+AdaptiveRadixTree<T, NodePolicy>::layoutOrder(InnerNode<T> *inner,
+                                              bool hot) {
+  // bounds the walk per child, the heat of a large subtree is
+  // estimated from its first leaves
+  constexpr size_t HOT_SCAN = 4096;
+  std::vector<uint8_t> order;
+  size_t heat[256];
+  int byte = 0;
+  for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+       ++byte, child = inner->nextChild(byte)) {
+    order.push_back(static_cast<uint8_t>(byte));
+    if (hot) {
+      size_t scan = HOT_SCAN;
+      heat[byte] = countReferenced(child, scan);
+    }
+  }
+  if (hot) {
+    std::stable_sort(order.begin(), order.end(), [&heat](uint8_t a, uint8_t b) {
+      return heat[a] > heat[b];
+    });
+  }
+  return order;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::countReferenced(Node<T> *node,
+                                                         size_t &scan) {
+  if (node->type() == NodeType::LeafNode) {
+    scan--;
+    return static_cast<LeafNode<T> *>(node)->isReferenced() ? 1 : 0;
+  }
+  auto inner = static_cast<InnerNode<T> *>(node);
+  size_t referenced = 0;
+  int byte = 0;
+  for (Node<T> *child = inner->nextChild(byte); child != nullptr && scan > 0;
+       ++byte, child = inner->nextChild(byte)) {
+    referenced += countReferenced(child, scan);
+  }
+  return referenced;
+}
+
+template <class T, class NodePolicy>
+template <class Policy>
+RC AdaptiveRadixTree<T, NodePolicy>::merge(
+    AdaptiveRadixTree<T, NodePolicy> &&other, Policy policy) {
+  appendPath_.clear();
+  other.appendPath_.clear();
+  if (&other == this || other.root_ == nullptr) {
+    return RC::SUCCESS;
+  }
+  if (root_ == nullptr) {
+    std::swap(root_, other.root_);
+  } else {
+    root_ = mergeNode(root_, other.root_, 0, policy, false);
+    other.root_ = nullptr;
+  }
+  tombstones_ += other.tombstones_;
+  other.tombstones_ = 0;
+  tombstoneKeys_.insert(tombstoneKeys_.end(), other.tombstoneKeys_.begin(),
+                        other.tombstoneKeys_.end());
+  other.tombstoneKeys_.clear();
+  other.bytes_ = 0;
+  rebudget();
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+template <class Policy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::mergeNode(Node<T> *node,
+                                                     Node<T> *other, int depth,
+                                                     Policy &policy,
+                                                     bool swapped) {
+  bool nodeIsLeaf = node->type() == NodeType::LeafNode;
+  bool otherIsLeaf = other->type() == NodeType::LeafNode;
+  // same key in both trees, resolve the value by policy
+  if (nodeIsLeaf && otherIsLeaf &&
+      static_cast<LeafNode<T> *>(node)->checkKeyMatch(
+          other->getPrefix(), other->getPrefixLen())) {
+    // a tombstone on either side gives way to the other leaf
+    if (static_cast<LeafNode<T> *>(other)->isTombstone()) {
+      Node<T>::release(other);
+      return node;
+    }
+    if (static_cast<LeafNode<T> *>(node)->isTombstone()) {
+      Node<T>::release(node);
+      return other;
+    }
+    auto mine = static_cast<LeafNode<T> *>(swapped ? other : node);
+    auto theirs = static_cast<LeafNode<T> *>(swapped ? node : other);
+    Value merged =
+        policy(node->getPrefix(), mine->getValue(), theirs->getValue());
+    node = own(node);
+    static_cast<LeafNode<T> *>(node)->setValue(merged);
+    Node<T>::release(other);
+    return node;
+  }
+
+  // inner nodes of both sides get their prefix or children rewritten
+  if (!nodeIsLeaf) {
+    node = own(node);
+  }
+  if (!otherIsLeaf) {
+    other = own(other);
+  }
+
+  // the bytes left to compare before the index key, a leaf compares
+  // the rest of its key including the terminating '\0'
+  auto bytes = [depth](Node<T> *n) {
+    return n->type() == NodeType::LeafNode ? n->getPrefix() + depth
+                                           : n->getPrefix();
+  };
+  auto length = [depth](Node<T> *n) {
+    return n->type() == NodeType::LeafNode ? n->getPrefixLen() - depth + 1
+                                           : n->getPrefixLen();
+  };
+  const char *nodeBytes = bytes(node);
+  const char *otherBytes = bytes(other);
+  int nodeLen = length(node);
+  int otherLen = length(other);
+  int matchLen = 0;
+  while (matchLen < nodeLen && matchLen < otherLen &&
+         nodeBytes[matchLen] == otherBytes[matchLen]) {
+    matchLen++;
+  }
+
+  // the prefixes diverge, hang both under a new node
+  if (matchLen < nodeLen && matchLen < otherLen) {
+    char *newPrefix = new char[matchLen + 1];
+    std::copy(nodeBytes, nodeBytes + matchLen, newPrefix);
+    newPrefix[matchLen] = '\0';
+    auto innerNode = new Node4<T>{newPrefix};
+    delete[] newPrefix;
+    if constexpr (ORDER_STATISTICS) {
+      innerNode->setCount(countLeaves(node) + countLeaves(other));
+    }
+    auto nodeKey = static_cast<uint8_t>(nodeBytes[matchLen]);
+    auto otherKey = static_cast<uint8_t>(otherBytes[matchLen]);
+    if (!nodeIsLeaf) {
+      static_cast<InnerNode<T> *>(node)->truncPrefix(matchLen + 1);
+    }
+    if (!otherIsLeaf) {
+      static_cast<InnerNode<T> *>(other)->truncPrefix(matchLen + 1);
+    }
+    innerNode->addChild(nodeKey, node);
+    innerNode->addChild(otherKey, other);
+    return innerNode;
+  }
+
+  // other has the shorter prefix, merge the other way round
+  if (matchLen == otherLen && otherLen < nodeLen) {
+    return mergeNode(other, node, depth, policy, !swapped);
+  }
+
+  auto inner = static_cast<InnerNode<T> *>(node);
+  int childDepth = depth + nodeLen + 1;
+  // node's prefix is a strict prefix of other's, other goes under a child
+  if (matchLen < otherLen) {
+    auto byte = static_cast<uint8_t>(otherBytes[matchLen]);
+    if (!otherIsLeaf) {
+      static_cast<InnerNode<T> *>(other)->truncPrefix(matchLen + 1);
+    }
+    Node<T> *child = inner->findChild(byte);
+    if (child != nullptr) {
+      inner->addChild(byte,
+                      mergeNode(child, other, childDepth, policy, swapped));
+    } else {
+      if (inner->isFull()) {
+        inner = growNode(inner);
+      }
+      inner->addChild(byte, other);
+    }
+    if constexpr (ORDER_STATISTICS) {
+      recount(inner);
+    }
+    return inner;
+  }
+
+  // same prefix, take the union of the children
+  auto otherInner = static_cast<InnerNode<T> *>(other);
+  int fanout = inner->getSize();
+  int byte = 0;
+  for (Node<T> *child = otherInner->nextChild(byte); child != nullptr;
+       ++byte, child = otherInner->nextChild(byte)) {
+    if (inner->findChild(byte) == nullptr) {
+      fanout++;
+    }
+  }
+  // pick the node type for the merged fanout up front
+  while (inner->getCapacity() < fanout) {
+    inner = growNode(inner);
+  }
+  byte = 0;
+  for (Node<T> *child = otherInner->nextChild(byte); child != nullptr;
+       ++byte, child = otherInner->nextChild(byte)) {
+    Node<T> *mine = inner->findChild(byte);
+    if (mine != nullptr) {
+      child = mergeNode(mine, child, childDepth, policy, swapped);
+    }
+    inner->addChild(byte, child);
+  }
+  otherInner->releaseChildren();
+  delete otherInner;
+  if constexpr (ORDER_STATISTICS) {
+    recount(inner);
+  }
+  return inner;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::eraseRange(const char *lo,
+                                                    const char *hi) {
+  appendPath_.clear();
+  if (root_ == nullptr ||
+      (lo != nullptr && hi != nullptr && std::strcmp(lo, hi) >= 0)) {
+    return 0;
+  }
+  size_t erased = 0;
+  root_ = eraseRange(root_, 0, lo, lo != nullptr, hi, hi != nullptr, erased);
+  rebudget();
+  return erased;
+}
+
+template <class T, class NodePolicy>
+Node<T> *AdaptiveRadixTree<T, NodePolicy>::eraseRange(Node<T> *node, int depth,
+                                                      const char *lo,
+                                                      bool loBound,
+                                                      const char *hi,
+                                                      bool hiBound,
+                                                      size_t &erased) {
+  if (node->type() == NodeType::LeafNode) {
+    const char *key = node->getPrefix();
+    if ((loBound && std::strcmp(key, lo) < 0) ||
+        (hiBound && std::strcmp(key, hi) >= 0)) {
+      return node;
+    }
+    erased += countLeaves(node);
+    Node<T>::release(node);
+    return nullptr;
+  }
+
+  // compare the prefix against both bounds, a bound that the whole
+  // subtree lies on the right side of doesn't constrain it anymore
+  const char *prefix = node->getPrefix();
+  int len = node->getPrefixLen();
+  for (int i = 0; i < len && (loBound || hiBound); ++i) {
+    auto byte = static_cast<uint8_t>(prefix[i]);
+    if (loBound && byte != static_cast<uint8_t>(lo[depth + i])) {
+      if (byte < static_cast<uint8_t>(lo[depth + i])) {
+        return node;
+      }
+      loBound = false;
+    }
+    if (hiBound && byte != static_cast<uint8_t>(hi[depth + i])) {
+      if (byte > static_cast<uint8_t>(hi[depth + i])) {
+        return node;
+      }
+      hiBound = false;
+    }
+  }
+  if (!loBound && !hiBound) {
+    erased += countLeaves(node);
+    Node<T>::release(node);
+    return nullptr;
+  }
+
+  auto inner = static_cast<InnerNode<T> *>(own(node));
+  int childDepth = depth + len + 1;
+  int loByte = loBound ? static_cast<uint8_t>(lo[depth + len]) : 0;
+  int hiByte = hiBound ? static_cast<uint8_t>(hi[depth + len]) : 255;
+  int byte = loByte;
+  for (Node<T> *child = inner->nextChild(byte);
+       child != nullptr && byte <= hiByte;
+       ++byte, child = inner->nextChild(byte)) {
+    bool childLo = loBound && byte == loByte;
+    bool childHi = hiBound && byte == hiByte;
+    Node<T> *rest = nullptr;
+    if (childLo || childHi) {
+      rest = eraseRange(child, childDepth, lo, childLo, hi, childHi, erased);
+    } else {
+      erased += countLeaves(child);
+      Node<T>::release(child);
+    }
+    if (rest == nullptr) {
+      inner->deleteChild(byte);
+    } else if (rest != child) {
+      inner->addChild(byte, rest);
+    }
+  }
+
+  if constexpr (ORDER_STATISTICS) {
+    recount(inner);
+  }
+  return shrinkToFit(inner);
+}
+
+template <class T, class NodePolicy>
+template <class Automaton, class Fn>
+void AdaptiveRadixTree<T, NodePolicy>::traverse(const Automaton &automaton,
+                                                Fn fn) {
+  if (root_ == nullptr) {
+    return;
+  }
+  auto state = automaton.start();
+  if (!automaton.isDead(state)) {
+    traverse(root_, 0, std::move(state), automaton, fn);
+  }
+}
+
+template <class T, class NodePolicy>
+template <class Automaton, class Fn>
+void AdaptiveRadixTree<T, NodePolicy>::traverse(
+    Node<T> *node, int depth, typename Automaton::State state,
+    const Automaton &automaton, Fn &fn) {
+  if (node->type() == NodeType::LeafNode) {
+    if (static_cast<LeafNode<T> *>(node)->isTombstone()) {
+      return;
+    }
+    // the rest of the full key
+    const char *key = node->getPrefix();
+    for (int i = depth; i < node->getPrefixLen(); ++i) {
+      state = automaton.step(state, static_cast<uint8_t>(key[i]));
+      if (automaton.isDead(state)) {
+        return;
+      }
+    }
+    if (automaton.isAccept(state)) {
+      fn(key, static_cast<LeafNode<T> *>(node)->getValue());
+    }
+    return;
+  }
+
+  const char *prefix = node->getPrefix();
+  int len = node->getPrefixLen();
+  for (int i = 0; i < len; ++i) {
+    state = automaton.step(state, static_cast<uint8_t>(prefix[i]));
+    if (automaton.isDead(state)) {
+      return;
+    }
+  }
+
+  auto inner = static_cast<InnerNode<T> *>(node);
+  int byte = 0;
+  for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+       ++byte, child = inner->nextChild(byte)) {
+    // '\0' terminates the key of the leaf below, nothing to feed
+    if (byte == 0) {
+      traverse(child, depth + len + 1, state, automaton, fn);
+      continue;
+    }
+    auto next = automaton.step(state, static_cast<uint8_t>(byte));
+    if (!automaton.isDead(next)) {
+      traverse(child, depth + len + 1, std::move(next), automaton, fn);
+    }
+  }
+}
+
+template <class T, class NodePolicy>
+template <class Fn>
+void AdaptiveRadixTree<T, NodePolicy>::parallelForEach(Fn fn,
+                                                       unsigned threads) {
+  parallelScan(nullptr, nullptr, fn, threads);
+}
+
+template <class T, class NodePolicy>
+template <class Fn>
+void AdaptiveRadixTree<T, NodePolicy>::parallelScan(const char *lo,
+                                                    const char *hi, Fn fn,
+                                                    unsigned threads) {
+  WorkStealingPool pool{threads};
+  std::vector<Node<T> *> subtrees = partition(lo, hi, pool.threads());
+  pool.run(subtrees.size(), [&](size_t task) {
+    for (Iterator<T> it{subtrees[task]}; it.valid(); it.next()) {
+      fn(it.getKey(), it.getValue());
+    }
+  });
+}
+
+template <class T, class NodePolicy>
+template <class Out, class Fn>
+Out AdaptiveRadixTree<T, NodePolicy>::parallelCollect(const char *lo,
+                                                      const char *hi, Fn fn,
+                                                      unsigned threads) {
+  WorkStealingPool pool{threads};
+  std::vector<Node<T> *> subtrees = partition(lo, hi, pool.threads());
+  std::vector<Out> parts(subtrees.size());
+  pool.run(subtrees.size(), [&](size_t task) {
+    for (Iterator<T> it{subtrees[task]}; it.valid(); it.next()) {
+      fn(parts[task], it.getKey(), it.getValue());
+    }
+  });
+  Out out;
+  for (auto &part : parts) {
+    out.insert(out.end(), std::make_move_iterator(part.begin()),
+               std::make_move_iterator(part.end()));
+  }
+  return out;
+}
+
+/**
+    @brief Where the keys starting with path lie relative to bound
+    @return -1 if all of them are < bound, 1 if all are >= bound,
+      0 if some are on either side
+ */
+inline int comparePath(const std::string &path, const char *bound) {
+  size_t i = 0;
+  while (i < path.size() && bound[i] != '\0' && path[i] == bound[i]) {
+    i++;
+  }
+  if (i == path.size()) {
+    // bound starts with path, only bound itself has nothing after it
+    return bound[i] == '\0' ? 1 : 0;
+  }
+  if (bound[i] == '\0') {
+    // path starts with bound, a '\0' in path ends a key equal to it
+    return 1;
+  }
+  if (static_cast<uint8_t>(path[i]) < static_cast<uint8_t>(bound[i])) {
+    return -1;
+  }
+  return 1;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::rangeSubtrees(
+    Node<T> *node, std::string &path, const char *lo, const char *hi,
+    std::vector<Node<T> *> &subtrees) {
+  if (node->type() == NodeType::LeafNode) {
+    const char *key = node->getPrefix();
+    if (!static_cast<LeafNode<T> *>(node)->isTombstone() &&
+        (lo == nullptr || std::strcmp(key, lo) >= 0) &&
+        (hi == nullptr || std::strcmp(key, hi) < 0)) {
+      subtrees.push_back(node);
+    }
+    return;
+  }
+  size_t depth = path.size();
+  path.append(node->getPrefix(), node->getPrefixLen());
+  int low = lo != nullptr ? comparePath(path, lo) : 1;
+  int high = hi != nullptr ? comparePath(path, hi) : -1;
+  if (low > 0 && high < 0) {
+    subtrees.push_back(node);
+  } else if (low >= 0 && high <= 0) {
+    auto inner = static_cast<InnerNode<T> *>(node);
+    int byte = 0;
+    for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+         ++byte, child = inner->nextChild(byte)) {
+      path.push_back(static_cast<char>(byte));
+      rangeSubtrees(child, path, lo, hi, subtrees);
+      path.pop_back();
+    }
+  }
+  path.resize(depth);
+}
+
+template <class T, class NodePolicy>
+std::vector<Node<T> *>
+AdaptiveRadixTree<T, NodePolicy>::partition(const char *lo, const char *hi,
+                                            unsigned threads) {
+  std::vector<Node<T> *> subtrees;
+  if (root_ == nullptr) {
+    return subtrees;
+  }
+  std::string path;
+  rangeSubtrees(root_, path, lo, hi, subtrees);
+  size_t target = size_t{threads} * PARALLEL_TASKS;
+  bool split = true;
+  while (split && subtrees.size() < target) {
+    split = false;
+    std::vector<Node<T> *> children;
+    children.reserve(subtrees.size() * 4);
+    for (Node<T> *node : subtrees) {
+      if (node->type() == NodeType::LeafNode) {
+        children.push_back(node);
+        continue;
+      }
+      // the children of a Node48 or Node256 come out sorted too
+      auto inner = static_cast<InnerNode<T> *>(node);
+      int byte = 0;
+      for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+           ++byte, child = inner->nextChild(byte)) {
+        children.push_back(child);
+      }
+      split = true;
+    }
+    subtrees.swap(children);
+  }
+  return subtrees;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::countLeaves(Node<T> *node) {
+  if (node->type() == NodeType::LeafNode) {
+    return static_cast<LeafNode<T> *>(node)->isTombstone() ? 0 : 1;
+  }
+  auto inner = static_cast<InnerNode<T> *>(node);
+  if constexpr (ORDER_STATISTICS) {
+    return inner->getCount();
+  }
+  size_t cnt = 0;
+  int byte = 0;
+  for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+       ++byte, child = inner->nextChild(byte)) {
+    cnt += countLeaves(child);
+  }
+  return cnt;
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::recount(InnerNode<T> *node) {
+  size_t cnt = 0;
+  int byte = 0;
+  for (Node<T> *child = node->nextChild(byte); child != nullptr;
+       ++byte, child = node->nextChild(byte)) {
+    cnt += countLeaves(child);
+  }
+  node->setCount(cnt);
+}
+
+template <class T, class NodePolicy>
+void AdaptiveRadixTree<T, NodePolicy>::addPathCount(const char *key,
+                                                    long long delta) {
+  size_t keyLen = std::strlen(key);
+  Node<T> *cur = root_;
+  int depth = 0;
+  while (cur != nullptr && cur->type() != NodeType::LeafNode) {
+    int len = cur->getPrefixLen();
+    if (cur->checkPrefix(key, keyLen, depth) != len) {
+      return;
+    }
+    static_cast<InnerNode<T> *>(cur)->addCount(delta);
+    depth += len;
+    cur = findChild(cur, key[depth]);
+    depth++;
+  }
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::rank(const char *key) {
+  static_assert(ORDER_STATISTICS, "rank needs a tree of Counted values");
+  size_t rank = 0;
+  size_t keyLen = std::strlen(key);
+  Node<T> *cur = root_;
+  int depth = 0;
+  while (cur != nullptr) {
+    if (cur->type() == NodeType::LeafNode) {
+      rank += std::strcmp(cur->getPrefix(), key) < 0 ? countLeaves(cur) : 0;
+      break;
+    }
+    int len = cur->getPrefixLen();
+    int matchLen = cur->checkPrefix(key, keyLen, depth);
+    if (matchLen != len) {
+      // the first unmatched byte orders the whole subtree against key
+      if (static_cast<uint8_t>(cur->getPrefix()[matchLen]) <
+          static_cast<uint8_t>(key[depth + matchLen])) {
+        rank += countLeaves(cur);
+      }
+      break;
+    }
+    depth += len;
+    // count the children left of the path
+    auto inner = static_cast<InnerNode<T> *>(cur);
+    int target = static_cast<uint8_t>(key[depth]);
+    int byte = 0;
+    for (Node<T> *child = inner->nextChild(byte);
+         child != nullptr && byte < target;
+         ++byte, child = inner->nextChild(byte)) {
+      rank += countLeaves(child);
+    }
+    cur = findChild(cur, key[depth]);
+    depth++;
+  }
+  return rank;
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::select(size_t k, std::string &key,
+                                            Value &value) {
+  static_assert(ORDER_STATISTICS, "select needs a tree of Counted values");
+  if (root_ == nullptr || k >= countLeaves(root_)) {
+    return RC::KEY_NOT_EXIST;
+  }
+  Node<T> *cur = root_;
+  while (cur->type() != NodeType::LeafNode) {
+    auto inner = static_cast<InnerNode<T> *>(cur);
+    int byte = 0;
+    for (Node<T> *child = inner->nextChild(byte); child != nullptr;
+         ++byte, child = inner->nextChild(byte)) {
+      size_t cnt = countLeaves(child);
+      if (k < cnt) {
+        cur = child;
+        break;
+      }
+      k -= cnt;
+    }
+  }
+  key = cur->getPrefix();
+  value = static_cast<LeafNode<T> *>(cur)->getValue();
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::countRange(const char *lo,
+                                                    const char *hi) {
+  static_assert(ORDER_STATISTICS,
+                "countRange needs a tree of Counted values");
+  size_t upper = hi == nullptr ? size() : rank(hi);
+  size_t lower = lo == nullptr ? 0 : rank(lo);
+  return upper > lower ? upper - lower : 0;
+}
+
+template <class T, class NodePolicy>
+size_t AdaptiveRadixTree<T, NodePolicy>::size() {
+  static_assert(ORDER_STATISTICS, "size needs a tree of Counted values");
+  return root_ == nullptr ? 0 : countLeaves(root_);
+}
+
+template <class T, class NodePolicy>
+AdaptiveRadixTree<T, NodePolicy>
+AdaptiveRadixTree<T, NodePolicy>::extractPrefix(const char *prefix) {
+  appendPath_.clear();
+  AdaptiveRadixTree<T, NodePolicy> subtree;
+  if (root_ == nullptr) {
+    return subtree;
+  }
+
+  int prefixLen = std::strlen(prefix);
+  Node<T> *pprev = nullptr;
+  uint8_t pprevKey = 0;
+  Node<T> *prev = nullptr;
+  uint8_t prevKey = 0;
+  Node<T> *cur = root_;
+  int depth = 0;
+  // ancestors of the detached subtree
+  std::vector<InnerNode<T> *> path;
+  while (true) {
+    if (cur->type() != NodeType::LeafNode) {
+      // copy the path shared with other versions on the way down
+      cur = ownChild(prev, prevKey, cur);
+    }
+    int matchLen = cur->checkPrefix(prefix, prefixLen, depth);
+    if (cur->type() == NodeType::LeafNode) {
+      if (depth + matchLen != prefixLen) {
+        return subtree;
+      }
+      break;
+    }
+    // prefix ends inside this node, every key below matches
+    if (depth + matchLen == prefixLen) {
+      break;
+    }
+    if (matchLen != cur->getPrefixLen()) {
+      return subtree;
+    }
+    depth += matchLen;
+    Node<T> *nxt = findChild(cur, prefix[depth]);
+    if (nxt == nullptr) {
+      return subtree;
+    }
+    if constexpr (ORDER_STATISTICS) {
+      path.push_back(static_cast<InnerNode<T> *>(cur));
+    }
+    pprevKey = prevKey;
+    pprev = prev;
+    prevKey = static_cast<uint8_t>(prefix[depth]);
+    prev = cur;
+    cur = nxt;
+    depth++;
+  }
+
+  if constexpr (ORDER_STATISTICS) {
+    size_t cnt = countLeaves(cur);
+    for (auto node : path) {
+      node->addCount(-static_cast<long long>(cnt));
+    }
+  }
+
+  // detach cur, the parent loses one child and is shrunk at most once
+  if (prev == nullptr) {
+    root_ = nullptr;
+  } else {
+    static_cast<InnerNode<T> *>(prev)->deleteChild(prevKey);
+    if (isUnderfull(static_cast<InnerNode<T> *>(prev))) {
+      relink(pprev, pprevKey, shrinkNode(static_cast<InnerNode<T> *>(prev)));
+    }
+  }
+
+  // the subtree root becomes a root, restore the bytes above it
+  if (cur->type() != NodeType::LeafNode && depth > 0) {
+    std::string fullPrefix{prefix, prefix + depth};
+    if (cur->getPrefixLen() > 0) {
+      fullPrefix.append(cur->getPrefix(), cur->getPrefixLen());
+    }
+    cur->resetPrefix(fullPrefix.c_str());
+  }
+  subtree.root_ = cur;
+  // both keep a bound, the tombstones aren't counted per subtree
+  subtree.tombstones_ = tombstones_;
+  for (const std::string &key : tombstoneKeys_) {
+    if (key.compare(0, prefixLen, prefix) == 0) {
+      subtree.tombstoneKeys_.push_back(key);
+    }
+  }
+  rebudget();
+  return subtree;
+}
+
+template <class T, class NodePolicy>
+RC AdaptiveRadixTree<T, NodePolicy>::erasePrefix(const char *prefix,
+                                                 bool background) {
+  AdaptiveRadixTree<T, NodePolicy> subtree = extractPrefix(prefix);
+  if (subtree.root_ == nullptr) {
+    return RC::KEY_NOT_EXIST;
+  }
+  if (background) {
+    reclaim();
+    reclaimer_ = std::thread([root = subtree.root_] {
+      Node<T>::release(root);
+    });
+    subtree.root_ = nullptr;
+  }
+  return RC::SUCCESS;
+}
+
 } // namespace art
 
 #endif
\ No newline at end of file
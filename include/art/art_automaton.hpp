@@ -0,0 +1,136 @@
+#ifndef ART_AUTOMATON_HPP
+#define ART_AUTOMATON_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Automata accepted by AdaptiveRadixTree::traverse
+      provide the following members:
+        State start() const;
+        State step(const State &state, uint8_t byte) const;
+        bool isDead(const State &state) const;   no accepting state reachable
+        bool isAccept(const State &state) const;
+ */
+
+/**
+    @brief Accept keys within a given edit distance of a word
+      the state is one row of the Levenshtein distance matrix
+ */
+class LevenshteinAutomaton {
+public:
+  using State = std::vector<int>;
+
+  LevenshteinAutomaton(const std::string &word, int maxDist)
+      : word_(word), maxDist_(maxDist) {}
+
+  State start() const;
+  State step(const State &state, uint8_t byte) const;
+  bool isDead(const State &state) const;
+  bool isAccept(const State &state) const;
+
+private:
+  std::string word_;
+  int maxDist_;
+};
+
+inline LevenshteinAutomaton::State LevenshteinAutomaton::start() const {
+  State state(word_.size() + 1);
+  for (size_t i = 0; i <= word_.size(); ++i) {
+    state[i] = std::min<int>(i, maxDist_ + 1);
+  }
+  return state;
+}
+
+inline LevenshteinAutomaton::State
+LevenshteinAutomaton::step(const State &state, uint8_t byte) const {
+  State next(state.size());
+  next[0] = std::min(state[0] + 1, maxDist_ + 1);
+  for (size_t i = 1; i < state.size(); ++i) {
+    int cost = static_cast<uint8_t>(word_[i - 1]) == byte ? 0 : 1;
+    int dist = std::min({state[i - 1] + cost, state[i] + 1, next[i - 1] + 1});
+    // distances beyond maxDist_ are all the same to us
+    next[i] = std::min(dist, maxDist_ + 1);
+  }
+  return next;
+}
+
+inline bool LevenshteinAutomaton::isDead(const State &state) const {
+  return *std::min_element(state.begin(), state.end()) > maxDist_;
+}
+
+inline bool LevenshteinAutomaton::isAccept(const State &state) const {
+  return state.back() <= maxDist_;
+}
+
+/**
+    @brief Accept keys matching a glob pattern
+      '*' matches any sequence of bytes, '?' matches a single byte,
+      the state is the set of pattern positions reached so far
+ */
+class GlobAutomaton {
+public:
+  using State = std::vector<bool>;
+
+  explicit GlobAutomaton(const std::string &pattern) : pattern_(pattern) {}
+
+  State start() const;
+  State step(const State &state, uint8_t byte) const;
+  bool isDead(const State &state) const;
+  bool isAccept(const State &state) const;
+
+private:
+  // a '*' may match the empty sequence, skip over it
+  void closure(State &state) const;
+
+  std::string pattern_;
+};
+
+inline void GlobAutomaton::closure(State &state) const {
+  for (size_t i = 0; i < pattern_.size(); ++i) {
+    if (state[i] && pattern_[i] == '*') {
+      state[i + 1] = true;
+    }
+  }
+}
+
+inline GlobAutomaton::State GlobAutomaton::start() const {
+  State state(pattern_.size() + 1, false);
+  state[0] = true;
+  closure(state);
+  return state;
+}
+
+inline GlobAutomaton::State GlobAutomaton::step(const State &state,
+                                                uint8_t byte) const {
+  State next(state.size(), false);
+  for (size_t i = 0; i < pattern_.size(); ++i) {
+    if (!state[i]) {
+      continue;
+    }
+    if (pattern_[i] == '*') {
+      next[i] = true;
+    } else if (pattern_[i] == '?' ||
+               static_cast<uint8_t>(pattern_[i]) == byte) {
+      next[i + 1] = true;
+    }
+  }
+  closure(next);
+  return next;
+}
+
+inline bool GlobAutomaton::isDead(const State &state) const {
+  return std::find(state.begin(), state.end(), true) == state.end();
+}
+
+inline bool GlobAutomaton::isAccept(const State &state) const {
+  return state.back();
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef ART_BUFFERED_HPP
+#define ART_BUFFERED_HPP
+
+#include "art.hpp"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Adaptive Radix Tree behind a small write buffer,
+      inserts and removes of buffered keys go to a run kept sorted by
+      key, reads binary search the run before the tree, once the run
+      is full it is applied to the tree through insertSorted, so that
+      neighbouring keys share the walk down instead of each insert
+      starting from the root
+ */
+template <class T, class NodePolicy = DefaultNodePolicy>
+class BufferedAdaptiveRadixTree {
+public:
+  using Tree = AdaptiveRadixTree<T, NodePolicy>;
+  using Value = typename Tree::Value;
+
+  // flush once capacity keys are buffered
+  explicit BufferedAdaptiveRadixTree(size_t capacity = 256)
+      : capacity_(capacity) {
+    run_.reserve(capacity_);
+  }
+
+  /**
+    @brief Given key, try to get the corresponding value
+    @param[out] value hold the value if key exists
+  */
+  RC search(const char *key, Value &value);
+
+  /**
+    @brief Given a <Key, Value> pair, buffer the insert
+      if key already exists, do update
+  */
+  RC insert(const char *key, const Value &value);
+
+  /**
+    @brief Given key, delete if exists, a buffered key is marked
+      deleted in the run, any other key is removed from the tree
+      right away
+    @param[out] value hold the value if key exists
+  */
+  RC remove(const char *key, Value &value);
+
+  // apply the run to the tree in key order
+  void flush();
+
+  // number of buffered writes
+  size_t buffered() const { return run_.size(); }
+
+  // the underlying tree with all writes applied
+  Tree &tree() {
+    flush();
+    return tree_;
+  }
+
+private:
+  // a key of the run and its value, no value is a pending delete
+  using Write = std::pair<std::string, std::optional<Value>>;
+
+  // first write whose key is not less than key
+  typename std::vector<Write>::iterator find(const char *key) {
+    return std::lower_bound(
+        run_.begin(), run_.end(), key,
+        [](const Write &write, const char *k) { return write.first < k; });
+  }
+
+  size_t capacity_;
+  // one write per key, sorted by key
+  std::vector<Write> run_;
+  Tree tree_;
+};
+
+template <class T, class NodePolicy>
+RC BufferedAdaptiveRadixTree<T, NodePolicy>::search(const char *key,
+                                                    Value &value) {
+  auto it = find(key);
+  if (it == run_.end() || it->first != key) {
+    return tree_.search(key, value);
+  }
+  if (!it->second) {
+    return RC::KEY_NOT_EXIST;
+  }
+  value = *it->second;
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+RC BufferedAdaptiveRadixTree<T, NodePolicy>::insert(const char *key,
+                                                    const Value &value) {
+  auto it = find(key);
+  if (it != run_.end() && it->first == key) {
+    it->second = value;
+    return RC::SUCCESS;
+  }
+  run_.emplace(it, key, value);
+  if (run_.size() >= capacity_) {
+    flush();
+  }
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+RC BufferedAdaptiveRadixTree<T, NodePolicy>::remove(const char *key,
+                                                    Value &value) {
+  auto it = find(key);
+  if (it == run_.end() || it->first != key) {
+    return tree_.remove(key, value);
+  }
+  if (!it->second) {
+    return RC::KEY_NOT_EXIST;
+  }
+  value = *it->second;
+  // the tree may still hold an older value of key
+  it->second.reset();
+  return RC::SUCCESS;
+}
+
+template <class T, class NodePolicy>
+void BufferedAdaptiveRadixTree<T, NodePolicy>::flush() {
+  std::vector<std::pair<const char *, Value>> inserts;
+  inserts.reserve(run_.size());
+  Value value;
+  // removes first, they would drop the path insertSorted walks down
+  for (auto &[key, write] : run_) {
+    if (write) {
+      inserts.emplace_back(key.c_str(), *write);
+    } else {
+      tree_.remove(key.c_str(), value);
+    }
+  }
+  tree_.insertSorted(inserts.begin(), inserts.end());
+  run_.clear();
+}
+
+} // namespace art
+
+#endif
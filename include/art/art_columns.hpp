@@ -0,0 +1,128 @@
+#ifndef ART_COLUMNS_HPP
+#define ART_COLUMNS_HPP
+
+#include "art.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace art {
+
+// what the buffers of exportColumns need to hold
+struct ColumnSizes {
+  size_t keys = 0;
+  // all keys back to back, without terminators
+  size_t keyBytes = 0;
+};
+
+/**
+    @brief A tree as contiguous arrays in key order, key i is
+      keys[offsets[i], offsets[i + 1]) and its value values[i]
+    @tparam Offset uint32_t for up to 4GB of key bytes, or uint64_t
+ */
+template <class T, class Offset = uint64_t> struct Columns {
+  std::vector<char> keys;
+  // one more than there are keys, the last one is keys.size()
+  std::vector<Offset> offsets;
+  std::vector<T> values;
+
+  size_t size() const { return values.size(); }
+
+  std::string_view key(size_t i) const {
+    return {keys.data() + offsets[i],
+            static_cast<size_t>(offsets[i + 1] - offsets[i])};
+  }
+};
+
+// count the keys and their bytes in one walk over the leaves
+template <class T, class NodePolicy>
+ColumnSizes columnSizes(AdaptiveRadixTree<T, NodePolicy> &tree) {
+  ColumnSizes sizes;
+  for (auto it = tree.begin(); it.valid(); it.next()) {
+    sizes.keys++;
+    sizes.keyBytes += it.getKeyLen();
+  }
+  return sizes;
+}
+
+/**
+    @brief Write the keys, their offsets and their values in key order
+      into preallocated buffers, in one in-order walk with an explicit
+      path stack, no recursion
+    @param[in] sizes capacity of the buffers, keys holds sizes.keyBytes
+      bytes, offsets sizes.keys + 1 entries and values sizes.keys
+    @return INTERNAL_FAILURE if the tree doesn't fit in sizes or the
+      key bytes overflow Offset, the buffers are then partly written
+ */
+template <class Offset, class T, class NodePolicy>
+RC exportColumns(AdaptiveRadixTree<T, NodePolicy> &tree, ColumnSizes sizes,
+                 char *keys, Offset *offsets, T *values) {
+  static_assert(std::is_same_v<Offset, uint32_t> ||
+                    std::is_same_v<Offset, uint64_t>,
+                "offsets are uint32_t or uint64_t");
+  size_t limit = std::min<uint64_t>(sizes.keyBytes,
+                                    std::numeric_limits<Offset>::max());
+  size_t count = 0, bytes = 0;
+  for (auto it = tree.begin(); it.valid(); it.next()) {
+    size_t len = it.getKeyLen();
+    if (count == sizes.keys || len > limit - bytes) {
+      return RC::INTERNAL_FAILURE;
+    }
+    offsets[count] = static_cast<Offset>(bytes);
+    values[count] = it.getValue();
+    std::memcpy(keys + bytes, it.getKey(), len);
+    bytes += len;
+    count++;
+  }
+  offsets[count] = static_cast<Offset>(bytes);
+  return RC::SUCCESS;
+}
+
+/**
+    @brief Export the tree into columns sized by columnSizes first
+    @throw std::overflow_error if the key bytes overflow Offset
+ */
+template <class Offset = uint64_t, class T, class NodePolicy>
+Columns<T, Offset> exportColumns(AdaptiveRadixTree<T, NodePolicy> &tree) {
+  ColumnSizes sizes = columnSizes(tree);
+  if (sizes.keyBytes > std::numeric_limits<Offset>::max()) {
+    throw std::overflow_error("key bytes overflow the offsets");
+  }
+  Columns<T, Offset> columns;
+  columns.keys.resize(sizes.keyBytes);
+  columns.offsets.resize(sizes.keys + 1);
+  columns.values.resize(sizes.keys);
+  exportColumns(tree, sizes, columns.keys.data(), columns.offsets.data(),
+                columns.values.data());
+  return columns;
+}
+
+/**
+    @brief Radix sort a batch of strings by building a tree and
+      exporting it, duplicates are dropped
+    @param[in] first/last range of std::string or const char *
+    @return the distinct strings in order, the value of each is the
+      position in the batch of its last occurrence
+ */
+template <class Offset = uint64_t, class InputIt>
+Columns<size_t, Offset> radixSort(InputIt first, InputIt last) {
+  AdaptiveRadixTree<size_t> tree;
+  for (size_t i = 0; first != last; ++first, ++i) {
+    if constexpr (std::is_convertible_v<decltype(*first), const char *>) {
+      tree.insert(*first, i);
+    } else {
+      tree.insert(first->c_str(), i);
+    }
+  }
+  return exportColumns<Offset>(tree);
+}
+
+} // namespace art
+
+#endif
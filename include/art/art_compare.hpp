@@ -0,0 +1,72 @@
+#ifndef ART_COMPARE_HPP
+#define ART_COMPARE_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__i386__) || defined(__amd64__)
+#include <immintrin.h>
+#endif
+
+namespace art {
+
+// index of the lowest addressed byte set in a nonzero word read from memory
+inline int firstByte(uint64_t word) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_ctzll(word) / 8;
+#else
+  return __builtin_clzll(word) / 8;
+#endif
+}
+
+/**
+    @brief Length of the common prefix of a[0, n) and b[0, n), compares
+      32 or 16 bytes at a time where SIMD is available, then 8 byte
+      words, and never reads outside [0, n) of either buffer
+ */
+inline int mismatch(const char *a, const char *b, int n) {
+  int i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+    auto equal =
+        static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+    if (equal != 0xFFFFFFFFU) {
+      return i + __builtin_ctz(~equal);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+    auto equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+    if (equal != 0xFFFFU) {
+      return i + __builtin_ctz(~equal);
+    }
+  }
+#endif
+  uint64_t x, y;
+  for (; i + 8 <= n; i += 8) {
+    std::memcpy(&x, a + i, sizeof(x));
+    std::memcpy(&y, b + i, sizeof(y));
+    if (x != y) {
+      return i + firstByte(x ^ y);
+    }
+  }
+  if (i < n && n >= 8) {
+    // the last word overlaps bytes already known to be equal
+    std::memcpy(&x, a + n - 8, sizeof(x));
+    std::memcpy(&y, b + n - 8, sizeof(y));
+    return x != y ? n - 8 + firstByte(x ^ y) : n;
+  }
+  while (i < n && a[i] == b[i]) {
+    i++;
+  }
+  return i;
+}
+
+} // namespace art
+
+#endif
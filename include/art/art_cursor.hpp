@@ -0,0 +1,214 @@
+#ifndef ART_CURSOR_HPP
+#define ART_CURSOR_HPP
+
+#include "art_inner_node.hpp"
+#include "art_leaf_node.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace art {
+
+template <class T, class NodePolicy> class AdaptiveRadixTree;
+
+/**
+    @brief Ordered cursor that caches the root-to-leaf path of its
+      current key, a seek only redoes the part of the path below the
+      common prefix of the current key and the sought one,
+      invalidated by any write to the tree like an iterator
+ */
+template <class T> class Cursor {
+  template <class, class> friend class AdaptiveRadixTree;
+
+public:
+  Cursor() = default;
+  explicit Cursor(Node<T> *root) : root_(root) {}
+
+  /**
+    @brief Position at the smallest key >= key
+    @return true if key exists
+  */
+  bool seek(const char *key) {
+    bool found = seekLeaf(key);
+    while (leaf_ != nullptr && leaf_->isTombstone()) {
+      found = false;
+      stepNext();
+    }
+    return found;
+  }
+
+  // false before the first seek and once moved past either end
+  bool valid() const { return leaf_ != nullptr; }
+
+  // move to the next key in order
+  void next() {
+    do {
+      stepNext();
+    } while (leaf_ != nullptr && leaf_->isTombstone());
+  }
+
+  // move to the previous key in order
+  void prev() {
+    do {
+      stepPrev();
+    } while (leaf_ != nullptr && leaf_->isTombstone());
+  }
+
+  // full key of the current leaf
+  const char *getKey() const { return leaf_->getPrefix(); }
+
+  // value of the current leaf, not available for a set
+  decltype(auto) getValue() const { return leaf_->getValue(); }
+
+private:
+  struct Frame {
+    InnerNode<T> *node;
+    // depth of the node's prefix in the key
+    int depth;
+    // index key of the child on the current path
+    int byte;
+  };
+
+  // position at the smallest leaf >= key, removed or not
+  bool seekLeaf(const char *key);
+
+  // move to the next or previous leaf, removed or not
+  void stepNext();
+  void stepPrev();
+
+  // go down to the leftmost leaf of node found at depth
+  void descendFirst(Node<T> *node, int depth);
+
+  // go down to the rightmost leaf of node found at depth
+  void descendLast(Node<T> *node, int depth);
+
+  Node<T> *root_ = nullptr;
+  std::vector<Frame> path_;
+  LeafNode<T> *leaf_ = nullptr;
+};
+
+template <class T> bool Cursor<T>::seekLeaf(const char *key) {
+  // nodes reached through the bytes shared with the current key
+  // are still on the path of key
+  size_t common = 0;
+  if (leaf_ != nullptr) {
+    const char *cur = leaf_->getPrefix();
+    while (cur[common] != '\0' && cur[common] == key[common]) {
+      common++;
+    }
+  } else {
+    path_.clear();
+  }
+  while (!path_.empty() && static_cast<size_t>(path_.back().depth) > common) {
+    path_.pop_back();
+  }
+
+  Node<T> *node = root_;
+  int depth = 0;
+  if (!path_.empty()) {
+    node = path_.back().node;
+    depth = path_.back().depth;
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+  if (node == nullptr) {
+    return false;
+  }
+
+  while (node->type() != NodeType::LeafNode) {
+    auto inner = static_cast<InnerNode<T> *>(node);
+    const char *prefix = node->getPrefix();
+    int len = node->getPrefixLen();
+    for (int i = 0; i < len; ++i) {
+      auto byte = static_cast<uint8_t>(prefix[i]);
+      auto target = static_cast<uint8_t>(key[depth + i]);
+      if (byte != target) {
+        if (byte > target) {
+          // the whole subtree is above key
+          descendFirst(node, depth);
+        } else {
+          // the whole subtree is below key, go past it
+          stepNext();
+        }
+        return false;
+      }
+    }
+    int target = static_cast<uint8_t>(key[depth + len]);
+    int byte = target;
+    Node<T> *child = inner->nextChild(byte);
+    if (child == nullptr) {
+      stepNext();
+      return false;
+    }
+    path_.push_back({inner, depth, byte});
+    depth += len + 1;
+    if (byte != target) {
+      descendFirst(child, depth);
+      return false;
+    }
+    node = child;
+  }
+
+  leaf_ = static_cast<LeafNode<T> *>(node);
+  int cmp = std::strcmp(leaf_->getPrefix(), key);
+  if (cmp < 0) {
+    stepNext();
+  }
+  return cmp == 0;
+}
+
+template <class T> void Cursor<T>::stepNext() {
+  while (!path_.empty()) {
+    Frame &frame = path_.back();
+    int byte = frame.byte + 1;
+    Node<T> *child = frame.node->nextChild(byte);
+    if (child != nullptr) {
+      frame.byte = byte;
+      descendFirst(child, frame.depth + frame.node->getPrefixLen() + 1);
+      return;
+    }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+template <class T> void Cursor<T>::stepPrev() {
+  while (!path_.empty()) {
+    Frame &frame = path_.back();
+    int byte = frame.byte - 1;
+    Node<T> *child = frame.node->prevChild(byte);
+    if (child != nullptr) {
+      frame.byte = byte;
+      descendLast(child, frame.depth + frame.node->getPrefixLen() + 1);
+      return;
+    }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+template <class T> void Cursor<T>::descendFirst(Node<T> *node, int depth) {
+  while (node->type() != NodeType::LeafNode) {
+    auto inner = static_cast<InnerNode<T> *>(node);
+    int byte = 0;
+    node = inner->nextChild(byte);
+    path_.push_back({inner, depth, byte});
+    depth += inner->getPrefixLen() + 1;
+  }
+  leaf_ = static_cast<LeafNode<T> *>(node);
+}
+
+template <class T> void Cursor<T>::descendLast(Node<T> *node, int depth) {
+  while (node->type() != NodeType::LeafNode) {
+    auto inner = static_cast<InnerNode<T> *>(node);
+    int byte = 255;
+    node = inner->prevChild(byte);
+    path_.push_back({inner, depth, byte});
+    depth += inner->getPrefixLen() + 1;
+  }
+  leaf_ = static_cast<LeafNode<T> *>(node);
+}
+
+} // namespace art
+
+#endif
@@ -5,10 +5,46 @@
 #include <algorithm>
 
 namespace art {
+
+// the unit nodes are laid out in
+constexpr size_t CACHE_LINE = 64;
+
+/**
+    @brief Compile time checks of the layout of an inner node type,
+      specialized once next to each node class, which befriends it
+ */
+template <template <class> class N> struct NodeLayout;
+
+/**
+    @brief The number of leaves under an inner node, only stored by the
+      nodes of a tree of Counted values
+ */
+template <bool counted> class LeafCount {
+public:
+  size_t getCount() const { return count_; }
+  void setCount(size_t count) { count_ = count; }
+  void addCount(long long delta) { count_ += delta; }
+
+private:
+  size_t count_ = 0;
+};
+
+// an empty base, always 0
+template <> class LeafCount<false> {
+public:
+  size_t getCount() const { return 0; }
+  void setCount(size_t) {}
+  void addCount(long long) {}
+};
+
 /**
-    @brief Adaptive Radix tree inner node base class
+    @brief Adaptive Radix tree inner node base class, inner nodes start
+      on a cache line so that the header and the keys a lookup scans
+      are fetched together
  */
-template <class T> class InnerNode : public Node<T> {
+template <class T>
+class alignas(CACHE_LINE) InnerNode : public Node<T>,
+                                      public LeafCount<isCounted<T>> {
 public:
   InnerNode() = default;
   InnerNode(const char *prefix) : Node<T>(prefix){};
@@ -20,6 +56,34 @@ public:
   virtual InnerNode<T> *grow() = 0;
   virtual Node<T> *shrink() = 0;
 
+  // copy of the node sharing all of its children
+  virtual InnerNode<T> *clone() const = 0;
+
+  // number of children
+  virtual int getSize() const = 0;
+
+  // max number of children before grow
+  virtual int getCapacity() const = 0;
+
+  // forget all children without freeing them
+  virtual void releaseChildren() = 0;
+
+  /**
+    @brief Find the child with the smallest index key >= byte
+    @param[in,out] byte the index key to start from,
+      hold the index key of the found child
+    @return the child node, if not exist, return nullptr
+  */
+  virtual Node<T> *nextChild(int &byte) = 0;
+
+  /**
+    @brief Find the child with the largest index key <= byte
+    @param[in,out] byte the index key to start from,
+      hold the index key of the found child
+    @return the child node, if not exist, return nullptr
+  */
+  virtual Node<T> *prevChild(int &byte) = 0;
+
   /**
     @brief Check if specific child is full,
       if yes, then do grow operation and renew the pointer
@@ -37,21 +101,36 @@ public:
   */
   virtual Node<T> *shrinkChild(uint8_t byte) = 0;
 
+  // memory findChild(byte) reads besides the node header
+  struct LookupSpan {
+    // index keys compared, nullptr if none
+    const void *keys;
+    size_t keysLen;
+    // child pointer read, nullptr if byte has no child
+    const void *slot;
+  };
+
+  /**
+    @brief Where findChild(byte) looks, to measure the cache lines
+      a lookup touches
+  */
+  virtual LookupSpan lookupSpan(uint8_t byte) const = 0;
+
   // truncate the first offset bytes off the prefix
   // keep [offset, prefixLen)
   void truncPrefix(int offset) {
     int len = this->prefixLen_ - offset;
     if (len == 0) {
-      delete this->prefix_;
+      freeNode(this->prefix_, this->prefixLen_ + 1);
       this->prefix_ = nullptr;
       this->prefixLen_ = 0;
       return;
     }
-    char *newPrefix = new char[len + 1];
+    auto newPrefix = static_cast<char *>(allocateNode(len + 1));
     std::copy(this->prefix_ + offset, this->prefix_ + this->prefixLen_,
               newPrefix);
     newPrefix[len] = '\0'; // for safety
-    delete this->prefix_;
+    freeNode(this->prefix_, this->prefixLen_ + 1);
     this->prefix_ = newPrefix;
     this->prefixLen_ = len;
   }
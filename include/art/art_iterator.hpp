@@ -0,0 +1,95 @@
+#ifndef ART_ITERATOR_HPP
+#define ART_ITERATOR_HPP
+
+#include "art_inner_node.hpp"
+#include "art_leaf_node.hpp"
+#include <vector>
+
+namespace art {
+
+/**
+    @brief In-order iterator over the leaves of a tree,
+      keeps the root-to-leaf path on a stack
+ */
+template <class T> class Iterator {
+public:
+  Iterator() = default;
+
+  // position at the smallest key of the subtree
+  explicit Iterator(Node<T> *root) {
+    if (root != nullptr) {
+      descend(root);
+      skipTombstones();
+    }
+  }
+
+  // false once the iterator moves past the last key
+  bool valid() const { return leaf_ != nullptr; }
+
+  // move to the next key in order
+  void next() {
+    step();
+    skipTombstones();
+  }
+
+  // full key of the current leaf
+  const char *getKey() const { return leaf_->getPrefix(); }
+
+  // length of getKey() without the terminator
+  int getKeyLen() const { return leaf_->getPrefixLen(); }
+
+  // value of the current leaf, not available for a set
+  decltype(auto) getValue() const { return leaf_->getValue(); }
+
+private:
+  struct Frame {
+    InnerNode<T> *node;
+    // index key of the child on the current path
+    int byte;
+  };
+
+  // go down to the leftmost leaf of node
+  void descend(Node<T> *node);
+
+  // move to the next leaf, removed or not
+  void step();
+
+  // lazily removed leaves are not visited
+  void skipTombstones() {
+    while (leaf_ != nullptr && leaf_->isTombstone()) {
+      step();
+    }
+  }
+
+  std::vector<Frame> path_;
+  LeafNode<T> *leaf_ = nullptr;
+};
+
+template <class T> void Iterator<T>::descend(Node<T> *node) {
+  while (node->type() != NodeType::LeafNode) {
+    auto inner = static_cast<InnerNode<T> *>(node);
+    int byte = 0;
+    node = inner->nextChild(byte);
+    path_.push_back({inner, byte});
+  }
+  leaf_ = static_cast<LeafNode<T> *>(node);
+}
+
+template <class T> void Iterator<T>::step() {
+  while (!path_.empty()) {
+    Frame &frame = path_.back();
+    int byte = frame.byte + 1;
+    Node<T> *child = frame.node->nextChild(byte);
+    if (child != nullptr) {
+      frame.byte = byte;
+      descend(child);
+      return;
+    }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+} // namespace art
+
+#endif
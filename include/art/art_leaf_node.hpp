@@ -2,22 +2,48 @@
 #define ART_LEAF_NODE_HPP
 
 #include "art_node.hpp"
+#include <type_traits>
 
 namespace art {
 
 template <class T> class AdaptiveRadixTreePrinter;
 
+// what the leaves of a set hold in place of a value
+struct NoValue {};
+
+template <class T> struct ValueType {
+  using type = std::conditional_t<std::is_void_v<T>, NoValue, T>;
+};
+
+template <class T> struct ValueType<Counted<T>> : ValueType<T> {};
+
+// the value type of a tree of T, NoValue for a set
+template <class T> using ValueOf = typename ValueType<T>::type;
+
+// the value of a leaf, an empty base for a set
+template <class T, bool = std::is_same_v<ValueOf<T>, NoValue>>
+class LeafValue {
+protected:
+  ValueOf<T> value_;
+};
+
+template <class T> class LeafValue<T, true> {
+protected:
+  static constexpr NoValue value_{};
+};
+
 /**
     @brief Adaptive Radix Tree Leaf node
-        store full key in prefix and its corresponding value
+        store full key in prefix and its corresponding value,
+        a leaf of a set, T = void, is just the node header
  */
-template <class T> class LeafNode : public Node<T> {
+template <class T> class LeafNode : public Node<T>, private LeafValue<T> {
   friend class AdaptiveRadixTreePrinter<T>;
 
 public:
-  LeafNode(const char *prefix, const T &value);
-  const T &getValue() const;
-  void setValue(const T &value);
+  LeafNode(const char *prefix, const ValueOf<T> &value = {});
+  const ValueOf<T> &getValue() const;
+  void setValue(const ValueOf<T> &value);
 
   /**
    * @brief For leaf node, given a key, check prefix match
@@ -27,42 +53,76 @@ public:
    */
   int checkPrefix(const char *key, int key_len, int depth) const override;
 
-  bool checkKeyMatch(const char *key, int key_len) const;
+  /**
+   * @brief Check that key is the key of the leaf, key[0...depth) is
+   * known to match already, e.g. by the path walked down to the leaf
+   */
+  bool checkKeyMatch(const char *key, int key_len, int depth = 0) const;
+
+  // removed lazily, still linked until the tree is purged
+  bool isTombstone() const { return this->hasFlag(Node<T>::TOMBSTONE); }
+  void setTombstone(bool tombstone) {
+    this->setFlag(Node<T>::TOMBSTONE, tombstone);
+  }
+
+  // accessed since the CLOCK hand last passed, set by readers
+  bool isReferenced() const { return this->hasFlag(Node<T>::REFERENCED); }
+  void setReferenced(bool referenced) {
+    // readers of a hot leaf mostly find it set already
+    if (isReferenced() != referenced) {
+      this->setFlag(Node<T>::REFERENCED, referenced);
+    }
+  }
 
-private:
-  T value_;
 };
 
 template <class T>
-LeafNode<T>::LeafNode(const char *prefix, const T &value) : Node<T>(prefix) {
-  value_ = value;
-  this->nodeType_ = NodeType::LeafNode;
+LeafNode<T>::LeafNode(const char *prefix, const ValueOf<T> &value)
+    : Node<T>(prefix) {
+  setValue(value);
+  this->setType(NodeType::LeafNode);
 }
 
-template <class T> const T &LeafNode<T>::getValue() const { return value_; }
+template <class T> const ValueOf<T> &LeafNode<T>::getValue() const {
+  return this->value_;
+}
 
-template <class T> void LeafNode<T>::setValue(const T &value) {
-  this->value_ = value;
+template <class T> void LeafNode<T>::setValue(const ValueOf<T> &value) {
+  if constexpr (!std::is_same_v<ValueOf<T>, NoValue>) {
+    this->value_ = value;
+  }
 }
 
 template <class T>
 int LeafNode<T>::checkPrefix(const char *key, int key_len, int depth) const {
-  int i = depth;
-  // [depth, i)
-  while (i < key_len && i < this->prefixLen_ && key[i] == this->prefix_[i]) {
-    i++;
+  int n = std::min(key_len, this->prefixLen_) - depth;
+  if (n <= 0) {
+    return 0;
   }
-  return i - depth;
+  int matched = mismatch(key + depth, this->prefix_ + depth, n);
+  countStat(Counter::PREFIX_BYTES, matched + (matched < n));
+  return matched;
 }
 
 template <class T>
-bool LeafNode<T>::checkKeyMatch(const char *key, int key_len) const {
+bool LeafNode<T>::checkKeyMatch(const char *key, int key_len,
+                                int depth) const {
   if (key_len != this->prefixLen_) {
     return false;
   }
-  return this->prefixLen_ == checkPrefix(key, key_len, 0);
+  int n = key_len - depth;
+  if (n <= 0) {
+    return true;
+  }
+  int matched = mismatch(key + depth, this->prefix_ + depth, n);
+  countStat(Counter::KEY_MATCH_BYTES, matched + (matched < n));
+  return matched == n;
 }
 
+static_assert(sizeof(LeafNode<void>) == sizeof(Node<void>) &&
+                  sizeof(LeafNode<void>) < sizeof(LeafNode<bool>),
+              "a leaf of a set is just the node header");
+
 } // namespace art
 
 #endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+#ifndef ART_LOGGED_HPP
+#define ART_LOGGED_HPP
+
+#include "art.hpp"
+#include "art_value_log.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Adaptive Radix Tree with its values kept out of line,
+      leaves only hold a Handle into a ValueLog so that large values
+      don't bloat the nodes a lookup walks through, updates and
+      removes leave garbage in the log that is reclaimed by compact(),
+      which runs by itself once enough of the log is garbage
+ */
+template <class T, class Handle = uint32_t> class LoggedAdaptiveRadixTree {
+public:
+  /**
+    @param[in] compactRatio compact once this fraction of the log is
+      garbage, 1 never compacts by itself
+  */
+  explicit LoggedAdaptiveRadixTree(double compactRatio = 0.5)
+      : compactRatio_(compactRatio) {}
+
+  /**
+    @brief Given key, try to get a copy of the corresponding value
+    @param[out] value hold the value if key exists
+  */
+  RC search(const char *key, T &value);
+
+  /**
+    @brief Given key, get the value without copying it
+    @return the value in the log, valid until the next insert, remove
+      or compact, nullptr if key does not exist
+  */
+  const T *view(const char *key);
+
+  /**
+    @brief Given a <Key, Value> pair, append the value to the log and
+      insert its handle, if key already exists, do update
+  */
+  RC insert(const char *key, const T &value);
+
+  /**
+    @brief Given key, delete it if exists
+    @param[out] value hold the value if key exists
+  */
+  RC remove(const char *key, T &value);
+
+  // move the live values to a new log, in key order
+  void compact();
+
+  const ValueLog<T, Handle> &log() const { return log_; }
+
+  // keys and the handles of their values
+  AdaptiveRadixTree<Handle> &tree() { return tree_; }
+
+private:
+  // logs with less garbage than this are not worth copying
+  static constexpr size_t MIN_GARBAGE = 1024;
+
+  void maybeCompact() {
+    if (log_.garbage() >= MIN_GARBAGE &&
+        log_.garbage() > compactRatio_ * log_.size()) {
+      compact();
+    }
+  }
+
+  double compactRatio_;
+  AdaptiveRadixTree<Handle> tree_;
+  ValueLog<T, Handle> log_;
+};
+
+template <class T, class Handle>
+RC LoggedAdaptiveRadixTree<T, Handle>::search(const char *key, T &value) {
+  const T *found = view(key);
+  if (found == nullptr) {
+    return RC::KEY_NOT_EXIST;
+  }
+  value = *found;
+  return RC::SUCCESS;
+}
+
+template <class T, class Handle>
+const T *LoggedAdaptiveRadixTree<T, Handle>::view(const char *key) {
+  Handle handle = 0;
+  if (tree_.search(key, handle) != RC::SUCCESS) {
+    return nullptr;
+  }
+  return &log_.get(handle);
+}
+
+template <class T, class Handle>
+RC LoggedAdaptiveRadixTree<T, Handle>::insert(const char *key,
+                                              const T &value) {
+  Handle old = 0;
+  bool update = tree_.search(key, old) == RC::SUCCESS;
+  tree_.insert(key, log_.append(value));
+  if (update) {
+    log_.discard(old);
+    maybeCompact();
+  }
+  return RC::SUCCESS;
+}
+
+template <class T, class Handle>
+RC LoggedAdaptiveRadixTree<T, Handle>::remove(const char *key, T &value) {
+  Handle handle = 0;
+  if (tree_.remove(key, handle) != RC::SUCCESS) {
+    return RC::KEY_NOT_EXIST;
+  }
+  value = std::move(log_.get(handle));
+  log_.discard(handle);
+  maybeCompact();
+  return RC::SUCCESS;
+}
+
+template <class T, class Handle>
+void LoggedAdaptiveRadixTree<T, Handle>::compact() {
+  ValueLog<T, Handle> fresh;
+  std::vector<std::pair<std::string, Handle>> moved;
+  moved.reserve(log_.live());
+  for (auto it = tree_.begin(); it.valid(); it.next()) {
+    moved.emplace_back(it.getKey(),
+                       fresh.append(std::move(log_.get(it.getValue()))));
+  }
+  // the keys come out sorted, every update resumes on the last path
+  tree_.insertSorted(moved.begin(), moved.end());
+  log_ = std::move(fresh);
+}
+
+} // namespace art
+
+#endif
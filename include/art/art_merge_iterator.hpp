@@ -0,0 +1,135 @@
+#ifndef ART_MERGE_ITERATOR_HPP
+#define ART_MERGE_ITERATOR_HPP
+
+#include "art.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Sorted view over several trees, e.g. a base and its deltas
+      or the trees of several shards, keys come out in global order
+      and a key held by several trees once, with the value of the tree
+      of the highest priority, the current cursor of every tree is kept
+      in a heap keyed on its key, a seek moves each cursor from its
+      cached path and skips the subtrees below the sought key, so a
+      scan driven by a sparse tree doesn't walk the whole of a dense one,
+      invalidated by any write to the trees like an iterator
+ */
+template <class T> class MergeIterator {
+public:
+  /**
+    @param[in] cursors cursors of the trees from the highest priority
+      to the lowest, positioned at the smallest key of all trees
+  */
+  explicit MergeIterator(std::vector<Cursor<T>> cursors)
+      : cursors_(std::move(cursors)) {
+    seek("");
+  }
+
+  /**
+    @brief Position at the smallest key >= key of all trees, cursors
+      already at or past key stay where they are on a forward seek
+    @return true if some tree holds key
+  */
+  bool seek(const char *key);
+
+  // false once moved past the last key of all trees
+  bool valid() const { return !heap_.empty(); }
+
+  // move to the next key in order
+  void next();
+
+  // full key of the current entry
+  const char *getKey() const { return cursors_[heap_.front()].getKey(); }
+
+  // value of the current entry in the tree of the highest priority
+  decltype(auto) getValue() const {
+    return cursors_[heap_.front()].getValue();
+  }
+
+  // index of the tree the current entry is taken from
+  size_t source() const { return heap_.front(); }
+
+private:
+  // heap order, the smallest key and then the highest priority on top
+  bool after(size_t a, size_t b) const {
+    int cmp = std::strcmp(cursors_[a].getKey(), cursors_[b].getKey());
+    return cmp > 0 || (cmp == 0 && a > b);
+  }
+
+  void push(size_t index) {
+    heap_.push_back(index);
+    std::push_heap(heap_.begin(), heap_.end(),
+                   [this](size_t a, size_t b) { return after(a, b); });
+  }
+
+  size_t pop() {
+    std::pop_heap(heap_.begin(), heap_.end(),
+                  [this](size_t a, size_t b) { return after(a, b); });
+    size_t index = heap_.back();
+    heap_.pop_back();
+    return index;
+  }
+
+  std::vector<Cursor<T>> cursors_;
+  // indexes of the cursors not past their last key
+  std::vector<size_t> heap_;
+  // cursors on the current key, kept to save allocations
+  std::vector<size_t> moved_;
+};
+
+template <class T> bool MergeIterator<T>::seek(const char *key) {
+  bool forward = valid() && std::strcmp(key, getKey()) >= 0;
+  bool found = false;
+  heap_.clear();
+  for (size_t i = 0; i < cursors_.size(); ++i) {
+    Cursor<T> &cursor = cursors_[i];
+    if (forward && !cursor.valid()) {
+      // past its last key already
+      continue;
+    }
+    if (forward && std::strcmp(cursor.getKey(), key) >= 0) {
+      found |= std::strcmp(cursor.getKey(), key) == 0;
+    } else {
+      found |= cursor.seek(key);
+    }
+    if (cursor.valid()) {
+      heap_.push_back(i);
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(),
+                 [this](size_t a, size_t b) { return after(a, b); });
+  return found;
+}
+
+template <class T> void MergeIterator<T>::next() {
+  // the key stays valid while the cursor holding it moves on
+  const char *key = getKey();
+  moved_.clear();
+  do {
+    moved_.push_back(pop());
+  } while (valid() && std::strcmp(getKey(), key) == 0);
+  for (size_t index : moved_) {
+    cursors_[index].next();
+    if (cursors_[index].valid()) {
+      push(index);
+    }
+  }
+}
+
+/**
+    @brief Merge iterator over trees given from the highest priority
+      to the lowest, positioned at the smallest key
+ */
+template <class T, class... NodePolicies>
+MergeIterator<T> mergeIterator(AdaptiveRadixTree<T, NodePolicies> &...trees) {
+  return MergeIterator<T>{std::vector<Cursor<T>>{trees.cursor()...}};
+}
+
+} // namespace art
+
+#endif
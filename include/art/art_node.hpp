@@ -1,6 +1,11 @@
 #ifndef ART_NODE_HPP
 #define ART_NODE_HPP
 
+#include "art_compare.hpp"
+#include "art_node_memory.hpp"
+#include "art_stats.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 
@@ -11,10 +16,24 @@ enum class NodeType : uint8_t {
   INVALID = 0,
   LeafNode,
   Node4,
+  Node8,
   Node16,
+  Node32,
   Node48,
   Node256,
 };
+static_assert(static_cast<int>(NodeType::Node256) + 1 == NODE_TYPES);
+
+/**
+    @brief Value type of a tree that keeps the number of leaves of every
+      subtree in its inner nodes, a tree of Counted<T> holds values of
+      T and supports rank, select, countRange and size
+ */
+template <class T> struct Counted {};
+
+// whether the inner nodes of a tree of T keep leaf counts
+template <class T> constexpr bool isCounted = false;
+template <class T> constexpr bool isCounted<Counted<T>> = true;
 
 /**
     @brief: base class for a node
@@ -26,7 +45,17 @@ public:
   Node(Node<T> &&other) = default;
   Node(const char *prefix);
 
-  virtual ~Node() { delete this->prefix_; };
+  virtual ~Node() { freeNode(this->prefix_, this->prefixLen_ + 1); };
+
+  // nodes come from the arenas set up by useNodeMemory, if any
+  static void *operator new(size_t size) { return allocateNode(size); }
+  static void *operator new(size_t size, std::align_val_t align) {
+    return allocateNode(size, static_cast<size_t>(align));
+  }
+  static void operator delete(void *ptr, size_t size) { freeNode(ptr, size); }
+  static void operator delete(void *ptr, size_t size, std::align_val_t align) {
+    freeNode(ptr, size, static_cast<size_t>(align));
+  }
 
   // is leaf or internal node
   NodeType type() const;
@@ -41,46 +70,107 @@ public:
   const char *getPrefix() const;
   void resetPrefix(const char *prefix);
 
+  // take one more reference to the node
+  void retain();
+
+  // referenced by more than one parent or tree, must not be modified
+  bool isShared() const;
+
+  // drop one reference, the last one frees the node and its subtree
+  static void release(Node<T> *node);
+
 protected:
+  // the type, the flags of a leaf and the number of parents and trees
+  // pointing to the node share one word, so the header is 24 bytes and
+  // a small value fits in a leaf without padding
+  static constexpr uint32_t TYPE_MASK = 0x07;
+  static constexpr uint32_t TOMBSTONE = 0x08;
+  static constexpr uint32_t REFERENCED = 0x10;
+  // the count of references takes the upper 24 bits
+  static constexpr uint32_t ONE_REF = 0x100;
+
+  void setType(NodeType type);
+  bool hasFlag(uint32_t flag) const;
+  void setFlag(uint32_t flag, bool on);
+
   char *prefix_ = nullptr;
   int prefixLen_ = 0;
-  NodeType nodeType_ = NodeType::INVALID;
+  std::atomic<uint32_t> state_{ONE_REF};
 };
 
 template <class T> Node<T>::Node(const char *prefix) {
   if (prefix != nullptr) {
     int len = std::strlen(prefix);
-    this->prefix_ = new char[len + 1];
+    this->prefix_ = static_cast<char *>(allocateNode(len + 1));
     std::memmove(this->prefix_, prefix, len);
     this->prefix_[len] = '\0'; // for safety
     this->prefixLen_ = len;
   }
 }
 
-template <class T> NodeType Node<T>::type() const { return this->nodeType_; }
+template <class T> NodeType Node<T>::type() const {
+  return static_cast<NodeType>(state_.load(std::memory_order_relaxed) &
+                               TYPE_MASK);
+}
+
+template <class T> void Node<T>::setType(NodeType type) {
+  // only set while the node is constructed
+  uint32_t state = state_.load(std::memory_order_relaxed);
+  state_.store((state & ~TYPE_MASK) | static_cast<uint32_t>(type),
+               std::memory_order_relaxed);
+}
+
+template <class T> bool Node<T>::hasFlag(uint32_t flag) const {
+  return (state_.load(std::memory_order_relaxed) & flag) != 0;
+}
+
+template <class T> void Node<T>::setFlag(uint32_t flag, bool on) {
+  if (on) {
+    state_.fetch_or(flag, std::memory_order_relaxed);
+  } else {
+    state_.fetch_and(~flag, std::memory_order_relaxed);
+  }
+}
 
 template <class T> int Node<T>::getPrefixLen() const { return prefixLen_; }
 
 template <class T> const char *Node<T>::getPrefix() const { return prefix_; }
 
 template <class T> void Node<T>::resetPrefix(const char *prefix) {
-  delete this->prefix_;
+  freeNode(this->prefix_, this->prefixLen_ + 1);
   int len = std::strlen(prefix);
-  this->prefix_ = new char[len + 1];
+  this->prefix_ = static_cast<char *>(allocateNode(len + 1));
   std::memmove(this->prefix_, prefix, len);
   this->prefix_[len] = '\0'; // for safety
   this->prefixLen_ = len;
 }
 
+template <class T> void Node<T>::retain() {
+  state_.fetch_add(ONE_REF, std::memory_order_relaxed);
+}
+
+template <class T> bool Node<T>::isShared() const {
+  return state_.load(std::memory_order_acquire) >= 2 * ONE_REF;
+}
+
+template <class T> void Node<T>::release(Node<T> *node) {
+  if (node != nullptr &&
+      node->state_.fetch_sub(ONE_REF, std::memory_order_acq_rel) <
+          2 * ONE_REF) {
+    delete node;
+  }
+}
+
 template <class T>
 int Node<T>::checkPrefix(const char *key, int key_len, int depth) const {
-  int ptrk = depth;
-  int ptrp = 0;
-  // [depth, ptrk)
-  while (ptrk < key_len && ptrp < prefixLen_ && key[ptrk] == prefix_[ptrp]) {
-    ptrk++, ptrp++;
+  int n = std::min(key_len - depth, prefixLen_);
+  if (n <= 0) {
+    return 0;
   }
-  return ptrk - depth;
+  int matched = mismatch(key + depth, prefix_, n);
+  // the mismatching byte was compared as well
+  countStat(Counter::PREFIX_BYTES, matched + (matched < n));
+  return matched;
 }
 
 } // namespace art
@@ -18,20 +18,21 @@ template <class T> class Node48;
 template <class T> class AdaptiveRadixTreePrinter;
 
 template <class T> class Node16 : public InnerNode<T> {
+  template <template <class> class> friend struct NodeLayout;
   friend class Node4<T>;
   friend class Node48<T>;
   friend class AdaptiveRadixTreePrinter<T>;
 
 public:
   Node16() {
-    this->nodeType_ = NodeType::Node16;
+    this->setType(NodeType::Node16);
     memset(key_, 0, sizeof(uint8_t) * MAX);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
   };
   Node16(const Node16<T> &);
   Node16(const char *prefix) : InnerNode<T>(prefix) {
-    this->nodeType_ = NodeType::Node16;
+    this->setType(NodeType::Node16);
     memset(key_, 0, sizeof(uint8_t) * MAX);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
@@ -43,9 +44,16 @@ public:
   bool isFull() const override;
   bool isLack() const override;
   InnerNode<T> *grow() override;
+  InnerNode<T> *clone() const override;
   Node<T> *shrink() override;
   Node<T> *growChild(uint8_t byte) override;
   Node<T> *shrinkChild(uint8_t byte) override;
+  int getSize() const override;
+  int getCapacity() const override;
+  void releaseChildren() override;
+  Node<T> *nextChild(int &byte) override;
+  Node<T> *prevChild(int &byte) override;
+  typename InnerNode<T>::LookupSpan lookupSpan(uint8_t byte) const override;
 
 private:
   static constexpr int MAX = 16;
@@ -55,23 +63,43 @@ private:
   Node<T> *child_[MAX];
 };
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+template <> struct NodeLayout<Node16> {
+  using N = Node16<void>;
+  // the leaf count of a Counted tree may push the keys past the line
+  using C = Node16<Counted<void>>;
+  static_assert(alignof(N) == CACHE_LINE && sizeof(N) % CACHE_LINE == 0 &&
+                    alignof(C) == CACHE_LINE && sizeof(C) % CACHE_LINE == 0,
+                "inner nodes fill whole cache lines");
+  static_assert(offsetof(N, key_) + N::MAX <= CACHE_LINE,
+                "the keys share the first line with the header");
+};
+#pragma GCC diagnostic pop
+
 template <class T>
 Node16<T>::Node16(const Node16<T> &other) : InnerNode<T>{other.prefix_} {
-  this->nodeType_ = NodeType::Node16;
+  this->setType(NodeType::Node16);
+  this->setCount(other.getCount());
   // set up <k, ptr>
   this->size_ = other.size_;
   std::copy(other.key_, other.key_ + other.size_, this->key_);
   std::copy(other.child_, other.child_ + other.size_, this->child_);
+  // the children are now shared with other
+  for (int i = 0; i < size_; ++i) {
+    child_[i]->retain();
+  }
 }
 
 template <class T> Node16<T>::~Node16() {
   for (int i = 0; i < size_; ++i) {
-    delete child_[i];
+    Node<T>::release(child_[i]);
   }
 }
 
 template <class T> Node<T> *Node16<T>::findChild(uint8_t byte) {
 #if defined(__i386__) || defined(__amd64__)
+  countStat(Counter::NODE16_SIMD);
   __m128i key = _mm_set1_epi8(byte);
   __m128i ndkey = _mm_loadu_si128((__m128i *)key_);
   __m128i mask = _mm_cmpeq_epi8(ndkey, key);
@@ -83,6 +111,7 @@ template <class T> Node<T> *Node16<T>::findChild(uint8_t byte) {
   }
 #endif
 
+  countStat(Counter::NODE16_SCALAR);
   int index = std::lower_bound(key_, key_ + size_, byte) - key_;
   if (key_[index] == byte) {
     return child_[index];
@@ -94,8 +123,10 @@ template <class T> void Node16<T>::addChild(uint8_t byte, Node<T> *child) {
   int index = size_;
 
 #if defined(__i386__) || defined(__amd64__)
-  __m128i key = _mm_set1_epi8(byte);
-  __m128i ndkey = _mm_loadu_si128((__m128i *)key_);
+  // flip the sign bit so the signed compare orders keys as unsigned bytes
+  __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  __m128i key = _mm_xor_si128(_mm_set1_epi8(byte), bias);
+  __m128i ndkey = _mm_xor_si128(_mm_loadu_si128((__m128i *)key_), bias);
   __m128i mask = _mm_cmpgt_epi8(ndkey, key);
   int bitfield = _mm_movemask_epi8(mask) & ((1 << size_) - 1);
   if (bitfield) {
@@ -123,7 +154,6 @@ template <class T> void Node16<T>::addChild(uint8_t byte, Node<T> *child) {
 }
 
 template <class T> void Node16<T>::deleteChild(uint8_t byte) {
-  assert(!isLack());
   int index = size_;
 
 #if defined(__i386__) || defined(__amd64__)
@@ -153,12 +183,18 @@ template <class T> bool Node16<T>::isFull() const { return size_ == MAX; }
 
 template <class T> bool Node16<T>::isLack() const { return size_ < MIN; }
 
+template <class T> InnerNode<T> *Node16<T>::clone() const {
+  return new Node16<T>{*this};
+}
+
 template <class T> InnerNode<T> *Node16<T>::grow() {
+  countStat(growCounter(this->type()));
   Node48<T> *newNode = new Node48<T>{this->prefix_};
+  newNode->setCount(this->getCount());
   newNode->size_ = this->size_;
 
   for (uint8_t i = 0; i < this->size_; ++i) {
-    char key = this->key_[i];
+    uint8_t key = this->key_[i];
     newNode->childIndex_[key] = i;
     newNode->child_[i] = this->child_[i];
     this->child_[i] = nullptr;
@@ -169,7 +205,9 @@ template <class T> InnerNode<T> *Node16<T>::grow() {
 }
 
 template <class T> Node<T> *Node16<T>::shrink() {
+  countStat(shrinkCounter(this->type()));
   Node4<T> *newNode = new Node4<T>{this->prefix_};
+  newNode->setCount(this->getCount());
   newNode->size_ = this->size_;
   for (uint8_t i = 0; i < this->size_; ++i) {
     newNode->key_[i] = this->key_[i];
@@ -235,6 +273,48 @@ template <class T> Node<T> *Node16<T>::shrinkChild(uint8_t byte) {
   return nullptr;
 }
 
+template <class T> int Node16<T>::getSize() const { return size_; }
+
+template <class T> int Node16<T>::getCapacity() const { return MAX; }
+
+template <class T> void Node16<T>::releaseChildren() {
+  for (int i = 0; i < size_; ++i) {
+    child_[i] = nullptr;
+  }
+  size_ = 0;
+}
+
+template <class T> Node<T> *Node16<T>::nextChild(int &byte) {
+  if (byte > 255) {
+    return nullptr;
+  }
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  if (index == size_) {
+    return nullptr;
+  }
+  byte = key_[index];
+  return child_[index];
+}
+
+template <class T> Node<T> *Node16<T>::prevChild(int &byte) {
+  if (byte < 0) {
+    return nullptr;
+  }
+  int index = std::upper_bound(key_, key_ + size_, byte) - key_;
+  if (index == 0) {
+    return nullptr;
+  }
+  byte = key_[index - 1];
+  return child_[index - 1];
+}
+
+template <class T>
+typename InnerNode<T>::LookupSpan Node16<T>::lookupSpan(uint8_t byte) const {
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  bool found = index < size_ && key_[index] == byte;
+  return {key_, MAX, found ? &child_[index] : nullptr};
+}
+
 } // namespace art
 
 #endif
\ No newline at end of file
@@ -14,18 +14,19 @@ template <class T> class Node48;
 template <class T> class AdaptiveRadixTreePrinter;
 
 template <class T> class Node256 : public InnerNode<T> {
+  template <template <class> class> friend struct NodeLayout;
   friend class Node48<T>;
   friend class AdaptiveRadixTreePrinter<T>;
 
 public:
   Node256() {
-    this->nodeType_ = NodeType::Node256;
+    this->setType(NodeType::Node256);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
   };
   Node256(const Node256<T> &);
   Node256(const char *prefix) : InnerNode<T>{prefix} {
-    this->nodeType_ = NodeType::Node256;
+    this->setType(NodeType::Node256);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
   }
@@ -36,37 +37,66 @@ public:
   bool isFull() const override;
   bool isLack() const override;
   InnerNode<T> *grow() override;
+  InnerNode<T> *clone() const override;
   Node<T> *shrink() override;
   Node<T> *growChild(uint8_t byte) override;
   Node<T> *shrinkChild(uint8_t byte) override;
+  int getSize() const override;
+  int getCapacity() const override;
+  void releaseChildren() override;
+  Node<T> *nextChild(int &byte) override;
+  Node<T> *prevChild(int &byte) override;
+  typename InnerNode<T>::LookupSpan lookupSpan(uint8_t byte) const override;
 
 private:
   static constexpr int MAX = 256;
   static constexpr int MIN = 49;
-  uint8_t size_ = 0;
+  // MAX doesn't fit in uint8_t
+  uint16_t size_ = 0;
   Node<T> *child_[MAX];
 };
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+template <> struct NodeLayout<Node256> {
+  using N = Node256<void>;
+  // the leaf count of a Counted tree may push the keys past the line
+  using C = Node256<Counted<void>>;
+  static_assert(alignof(N) == CACHE_LINE && sizeof(N) % CACHE_LINE == 0 &&
+                    alignof(C) == CACHE_LINE && sizeof(C) % CACHE_LINE == 0,
+                "inner nodes fill whole cache lines");
+  static_assert(offsetof(N, child_) <= CACHE_LINE,
+                "the header fits in the first line");
+};
+#pragma GCC diagnostic pop
+
 template <class T> Node<T> *Node256<T>::findChild(uint8_t byte) {
   return child_[byte];
 }
 
 template <class T>
 Node256<T>::Node256(const Node256<T> &other) : InnerNode<T>{other.prefix_} {
-  this->nodeType_ = NodeType::Node256;
+  this->setType(NodeType::Node256);
+  this->setCount(other.getCount());
   this->size_ = other.size_;
   std::copy(other.child_, other.child_ + MAX, this->child_);
+  // the children are now shared with other
+  for (int i = 0; i < MAX; ++i) {
+    if (child_[i] != nullptr) {
+      child_[i]->retain();
+    }
+  }
 }
 
 template <class T> Node256<T>::~Node256() {
   for (int i = 0; i < MAX; ++i) {
-    delete child_[i];
+    Node<T>::release(child_[i]);
   }
 }
 
 template <class T> void Node256<T>::addChild(uint8_t byte, Node<T> *child) {
   auto index = byte;
-  if (child_[index] == nullptr) {
+  if (child_[index] != nullptr) {
     child_[index] = child;
     return;
   }
@@ -76,22 +106,29 @@ template <class T> void Node256<T>::addChild(uint8_t byte, Node<T> *child) {
 }
 
 template <class T> void Node256<T>::deleteChild(uint8_t byte) {
-  assert(!isLack());
   auto index = byte;
-  child_[index] = nullptr;
-  size_--;
+  if (child_[index] != nullptr) {
+    child_[index] = nullptr;
+    size_--;
+  }
 }
 
 template <class T> bool Node256<T>::isFull() const { return size_ == MAX; }
 
 template <class T> bool Node256<T>::isLack() const { return size_ < MIN; }
 
+template <class T> InnerNode<T> *Node256<T>::clone() const {
+  return new Node256<T>{*this};
+}
+
 template <class T> InnerNode<T> *Node256<T>::grow() {
   throw std::runtime_error("Node256 don't grow");
 }
 
 template <class T> Node<T> *Node256<T>::shrink() {
+  countStat(shrinkCounter(this->type()));
   auto newNode = new Node48<T>{this->prefix_};
+  newNode->setCount(this->getCount());
   newNode->size_ = this->size_;
   uint8_t cnt = 0;
   for (int key = 0; key < MAX && cnt < this->size_; ++key) {
@@ -125,6 +162,41 @@ template <class T> Node<T> *Node256<T>::shrinkChild(uint8_t byte) {
   return child_[byte];
 }
 
+template <class T> int Node256<T>::getSize() const { return size_; }
+
+template <class T> int Node256<T>::getCapacity() const { return MAX; }
+
+template <class T> void Node256<T>::releaseChildren() {
+  std::fill(child_, child_ + MAX, nullptr);
+  size_ = 0;
+}
+
+template <class T> Node<T> *Node256<T>::nextChild(int &byte) {
+  for (int key = std::max(byte, 0); key < MAX; ++key) {
+    if (child_[key] != nullptr) {
+      byte = key;
+      return child_[key];
+    }
+  }
+  return nullptr;
+}
+
+template <class T> Node<T> *Node256<T>::prevChild(int &byte) {
+  for (int key = std::min(byte, MAX - 1); key >= 0; --key) {
+    if (child_[key] != nullptr) {
+      byte = key;
+      return child_[key];
+    }
+  }
+  return nullptr;
+}
+
+template <class T>
+typename InnerNode<T>::LookupSpan
+Node256<T>::lookupSpan(uint8_t byte) const {
+  return {nullptr, 0, &child_[byte]};
+}
+
 } // namespace art
 
 #endif
\ No newline at end of file
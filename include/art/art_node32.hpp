@@ -0,0 +1,264 @@
+#ifndef ART_NODE32_HPP
+#define ART_NODE32_HPP
+
+#include "art_inner_node.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__i386__) || defined(__amd64__)
+#include <immintrin.h>
+#endif
+
+namespace art {
+
+template <class T> class Node16;
+template <class T> class Node48;
+template <class T> class AdaptiveRadixTreePrinter;
+
+/**
+    @brief Inner node between Node16 and Node48, only used by node
+      policies that ask for it, the 32 sorted index keys are compared
+      with one AVX2 instruction or two SSE2 ones
+ */
+template <class T> class Node32 : public InnerNode<T> {
+  template <template <class> class> friend struct NodeLayout;
+  friend class AdaptiveRadixTreePrinter<T>;
+
+public:
+  Node32() {
+    this->setType(NodeType::Node32);
+    memset(key_, 0, sizeof(uint8_t) * MAX);
+    for (int i = 0; i < MAX; ++i)
+      child_[i] = nullptr;
+  };
+  Node32(const Node32<T> &);
+  Node32(const char *prefix) : InnerNode<T>(prefix) {
+    this->setType(NodeType::Node32);
+    memset(key_, 0, sizeof(uint8_t) * MAX);
+    for (int i = 0; i < MAX; ++i)
+      child_[i] = nullptr;
+  }
+  ~Node32();
+  Node<T> *findChild(uint8_t byte) override;
+  void addChild(uint8_t byte, Node<T> *child) override;
+  void deleteChild(uint8_t byte) override;
+  bool isFull() const override;
+  bool isLack() const override;
+  InnerNode<T> *grow() override;
+  InnerNode<T> *clone() const override;
+  Node<T> *shrink() override;
+  Node<T> *growChild(uint8_t byte) override;
+  Node<T> *shrinkChild(uint8_t byte) override;
+  int getSize() const override;
+  int getCapacity() const override;
+  void releaseChildren() override;
+  Node<T> *nextChild(int &byte) override;
+  Node<T> *prevChild(int &byte) override;
+  typename InnerNode<T>::LookupSpan lookupSpan(uint8_t byte) const override;
+
+private:
+  // index of the key equal to byte, size_ if not exist
+  int find(uint8_t byte) const;
+
+  static constexpr int MAX = 32;
+  static constexpr int MIN = 9;
+  // the keys ahead of size_ fill the rest of the first line, so the
+  // 32 byte compare loads them from one line
+  uint8_t key_[MAX];
+  uint8_t size_ = 0;
+  Node<T> *child_[MAX];
+};
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+template <> struct NodeLayout<Node32> {
+  using N = Node32<void>;
+  // the leaf count of a Counted tree may push the keys past the line
+  using C = Node32<Counted<void>>;
+  static_assert(alignof(N) == CACHE_LINE && sizeof(N) % CACHE_LINE == 0 &&
+                    alignof(C) == CACHE_LINE && sizeof(C) % CACHE_LINE == 0,
+                "inner nodes fill whole cache lines");
+  static_assert(offsetof(N, key_) + N::MAX <= CACHE_LINE,
+                "the keys share the first line with the header");
+};
+#pragma GCC diagnostic pop
+
+template <class T>
+Node32<T>::Node32(const Node32<T> &other) : InnerNode<T>(other.prefix_) {
+  this->setType(NodeType::Node32);
+  this->setCount(other.getCount());
+  this->size_ = other.size_;
+  std::copy(other.key_, other.key_ + MAX, this->key_);
+  std::copy(other.child_, other.child_ + other.size_, this->child_);
+  // the children are now shared with other
+  for (int i = 0; i < size_; ++i) {
+    child_[i]->retain();
+  }
+}
+
+template <class T> Node32<T>::~Node32() {
+  for (int i = 0; i < size_; ++i) {
+    Node<T>::release(child_[i]);
+  }
+}
+
+template <class T> int Node32<T>::find(uint8_t byte) const {
+#if defined(__i386__) || defined(__amd64__)
+#if defined(__AVX2__)
+  __m256i key = _mm256_set1_epi8(byte);
+  __m256i ndkey = _mm256_loadu_si256((const __m256i *)key_);
+  auto bitfield = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(ndkey, key)));
+#else
+  // two halves of 16 keys each
+  __m128i key = _mm_set1_epi8(byte);
+  __m128i lo = _mm_loadu_si128((const __m128i *)key_);
+  __m128i hi = _mm_loadu_si128((const __m128i *)(key_ + 16));
+  auto bitfield =
+      static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lo, key))) |
+      static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hi, key)))
+          << 16;
+#endif
+  if (size_ < MAX) {
+    bitfield &= (1U << size_) - 1;
+  }
+  return bitfield ? __builtin_ctz(bitfield) : size_;
+#else
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  return index < size_ && key_[index] == byte ? index : size_;
+#endif
+}
+
+template <class T> Node<T> *Node32<T>::findChild(uint8_t byte) {
+  int index = find(byte);
+  return index < size_ ? child_[index] : nullptr;
+}
+
+template <class T> void Node32<T>::addChild(uint8_t byte, Node<T> *child) {
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  if (index < size_ && key_[index] == byte) {
+    child_[index] = child;
+    return;
+  }
+  assert(!isFull());
+  // move [index, size_ - 1] back
+  size_t n = size_ - index;
+  std::memmove(key_ + index + 1, key_ + index, n);
+  std::memmove(child_ + index + 1, child_ + index, n * sizeof(Node<T> *));
+  key_[index] = byte;
+  child_[index] = child;
+  size_++;
+}
+
+template <class T> void Node32<T>::deleteChild(uint8_t byte) {
+  int index = find(byte);
+  if (index == size_) {
+    return;
+  }
+  // move [index + 1, size_ - 1] forword
+  size_t n = size_ - index - 1;
+  std::memmove(key_ + index, key_ + index + 1, n);
+  std::memmove(child_ + index, child_ + index + 1, n * sizeof(Node<T> *));
+  size_--;
+}
+
+template <class T> bool Node32<T>::isFull() const { return size_ == MAX; }
+
+template <class T> bool Node32<T>::isLack() const { return size_ < MIN; }
+
+template <class T> InnerNode<T> *Node32<T>::clone() const {
+  return new Node32<T>{*this};
+}
+
+template <class T> InnerNode<T> *Node32<T>::grow() {
+  countStat(growCounter(this->type()));
+  auto newNode = new Node48<T>{this->prefix_};
+  newNode->setCount(this->getCount());
+  for (int i = 0; i < size_; ++i) {
+    newNode->addChild(key_[i], child_[i]);
+  }
+  releaseChildren();
+  delete this;
+  return newNode;
+}
+
+template <class T> Node<T> *Node32<T>::shrink() {
+  countStat(shrinkCounter(this->type()));
+  assert(size_ <= 16);
+  auto newNode = new Node16<T>{this->prefix_};
+  newNode->setCount(this->getCount());
+  for (int i = 0; i < size_; ++i) {
+    newNode->addChild(key_[i], child_[i]);
+  }
+  releaseChildren();
+  delete this;
+  return newNode;
+}
+
+template <class T> Node<T> *Node32<T>::growChild(uint8_t byte) {
+  int index = find(byte);
+  if (index == size_) {
+    return nullptr;
+  }
+  assert(child_[index]->type() != NodeType::LeafNode);
+  assert(static_cast<InnerNode<T> *>(child_[index])->isFull());
+  child_[index] = static_cast<InnerNode<T> *>(child_[index])->grow();
+  return child_[index];
+}
+
+template <class T> Node<T> *Node32<T>::shrinkChild(uint8_t byte) {
+  int index = find(byte);
+  if (index == size_) {
+    return nullptr;
+  }
+  assert(child_[index]->type() != NodeType::LeafNode);
+  assert(static_cast<InnerNode<T> *>(child_[index])->isLack());
+  child_[index] = static_cast<InnerNode<T> *>(child_[index])->shrink();
+  return child_[index];
+}
+
+template <class T> int Node32<T>::getSize() const { return size_; }
+
+template <class T> int Node32<T>::getCapacity() const { return MAX; }
+
+template <class T> void Node32<T>::releaseChildren() {
+  std::fill(child_, child_ + MAX, nullptr);
+  size_ = 0;
+}
+
+template <class T> Node<T> *Node32<T>::nextChild(int &byte) {
+  if (byte > 255) {
+    return nullptr;
+  }
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  if (index == size_) {
+    return nullptr;
+  }
+  byte = key_[index];
+  return child_[index];
+}
+
+template <class T> Node<T> *Node32<T>::prevChild(int &byte) {
+  if (byte < 0) {
+    return nullptr;
+  }
+  int index = std::upper_bound(key_, key_ + size_, byte) - key_;
+  if (index == 0) {
+    return nullptr;
+  }
+  byte = key_[index - 1];
+  return child_[index - 1];
+}
+
+template <class T>
+typename InnerNode<T>::LookupSpan Node32<T>::lookupSpan(uint8_t byte) const {
+  int index = find(byte);
+  return {key_, MAX, index < size_ ? &child_[index] : nullptr};
+}
+
+} // namespace art
+
+#endif
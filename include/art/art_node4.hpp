@@ -14,12 +14,13 @@ template <class T> class Node16;
 template <class T> class AdaptiveRadixTreePrinter;
 
 template <class T> class Node4 : public InnerNode<T> {
+  template <template <class> class> friend struct NodeLayout;
   friend class Node16<T>;
   friend class AdaptiveRadixTreePrinter<T>;
 
 public:
   Node4() {
-    this->nodeType_ = NodeType::Node4;
+    this->setType(NodeType::Node4);
     memset(key_, 0, sizeof(uint8_t) * MAX);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
@@ -27,7 +28,7 @@ public:
 
   Node4(const Node4<T> &);
   Node4(const char *prefix) : InnerNode<T>(prefix) {
-    this->nodeType_ = NodeType::Node4;
+    this->setType(NodeType::Node4);
     memset(key_, 0, sizeof(uint8_t) * MAX);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
@@ -39,6 +40,7 @@ public:
   bool isFull() const override;
   bool isLack() const override;
   InnerNode<T> *grow() override;
+  InnerNode<T> *clone() const override;
 
   /**
     @brief if has only one child, do path compression
@@ -49,6 +51,12 @@ public:
 
   Node<T> *growChild(uint8_t byte) override;
   Node<T> *shrinkChild(uint8_t byte) override;
+  int getSize() const override;
+  int getCapacity() const override;
+  void releaseChildren() override;
+  Node<T> *nextChild(int &byte) override;
+  Node<T> *prevChild(int &byte) override;
+  typename InnerNode<T>::LookupSpan lookupSpan(uint8_t byte) const override;
 
 private:
   static constexpr int MAX = 4;
@@ -58,18 +66,39 @@ private:
   Node<T> *child_[MAX];
 };
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+template <> struct NodeLayout<Node4> {
+  using N = Node4<void>;
+  // the leaf count of a Counted tree may push the keys past the line
+  using C = Node4<Counted<void>>;
+  static_assert(alignof(N) == CACHE_LINE && sizeof(N) % CACHE_LINE == 0 &&
+                    alignof(C) == CACHE_LINE && sizeof(C) % CACHE_LINE == 0,
+                "inner nodes fill whole cache lines");
+  static_assert(offsetof(N, key_) + N::MAX <= CACHE_LINE,
+                "the keys share the first line with the header");
+  static_assert(sizeof(N) == CACHE_LINE,
+                "the smallest node is one line");
+};
+#pragma GCC diagnostic pop
+
 template <class T>
 Node4<T>::Node4(const Node4<T> &other) : InnerNode<T>(other.prefix_) {
-  this->nodeType_ = NodeType::Node4;
+  this->setType(NodeType::Node4);
+  this->setCount(other.getCount());
   this->size_ = other.size_;
   // set up <k, ptr>
   std::copy(other.key_, other.key_ + other.size_, this->key_);
   std::copy(other.child_, other.child_ + other.size_, this->child_);
+  // the children are now shared with other
+  for (int i = 0; i < size_; ++i) {
+    child_[i]->retain();
+  }
 }
 
 template <class T> Node4<T>::~Node4() {
   for (int i = 0; i < size_; ++i) {
-    delete child_[i];
+    Node<T>::release(child_[i]);
   }
 }
 
@@ -104,7 +133,6 @@ template <class T> void Node4<T>::addChild(uint8_t byte, Node<T> *child) {
 }
 
 template <class T> void Node4<T>::deleteChild(uint8_t byte) {
-  assert(!isLack());
   int idx = 0;
   while (idx < size_ && byte > key_[idx]) {
     idx++;
@@ -124,8 +152,14 @@ template <class T> bool Node4<T>::isFull() const { return size_ == MAX; }
 
 template <class T> bool Node4<T>::isLack() const { return size_ <= MIN; }
 
+template <class T> InnerNode<T> *Node4<T>::clone() const {
+  return new Node4<T>{*this};
+}
+
 template <class T> InnerNode<T> *Node4<T>::grow() {
+  countStat(growCounter(this->type()));
   Node16<T> *newNode = new Node16<T>{this->prefix_};
+  newNode->setCount(this->getCount());
   newNode->size_ = this->size_;
   for (uint8_t i = 0; i < size_; ++i) {
     newNode->key_[i] = this->key_[i];
@@ -137,9 +171,16 @@ template <class T> InnerNode<T> *Node4<T>::grow() {
 }
 
 template <class T> Node<T> *Node4<T>::shrink() {
+  countStat(shrinkCounter(this->type()));
   assert(this->size_ == MIN);
   Node<T> *newNode = this->child_[0];
   if (newNode->type() != NodeType::LeafNode) {
+    if (newNode->isShared()) {
+      // the prefix is about to change, other versions keep the original
+      Node<T> *copy = static_cast<InnerNode<T> *>(newNode)->clone();
+      Node<T>::release(newNode);
+      newNode = copy;
+    }
     char *curPrefix = this->prefix_;
     char *childPrefix = const_cast<char *>(newNode->getPrefix());
 
@@ -185,6 +226,47 @@ template <class T> Node<T> *Node4<T>::shrinkChild(uint8_t byte) {
   return nullptr;
 }
 
+template <class T> int Node4<T>::getSize() const { return size_; }
+
+template <class T> int Node4<T>::getCapacity() const { return MAX; }
+
+template <class T> void Node4<T>::releaseChildren() {
+  for (int i = 0; i < size_; ++i) {
+    child_[i] = nullptr;
+  }
+  size_ = 0;
+}
+
+template <class T> Node<T> *Node4<T>::nextChild(int &byte) {
+  for (int i = 0; i < size_; ++i) {
+    if (key_[i] >= byte) {
+      byte = key_[i];
+      return child_[i];
+    }
+  }
+  return nullptr;
+}
+
+template <class T> Node<T> *Node4<T>::prevChild(int &byte) {
+  for (int i = size_ - 1; i >= 0; --i) {
+    if (key_[i] <= byte) {
+      byte = key_[i];
+      return child_[i];
+    }
+  }
+  return nullptr;
+}
+
+template <class T>
+typename InnerNode<T>::LookupSpan Node4<T>::lookupSpan(uint8_t byte) const {
+  for (int i = 0; i < size_; ++i) {
+    if (key_[i] == byte) {
+      return {key_, size_, &child_[i]};
+    }
+  }
+  return {key_, size_, nullptr};
+}
+
 } // namespace art
 
 #endif
\ No newline at end of file
@@ -14,6 +14,7 @@ template <class T> class Node256;
 template <class T> class AdaptiveRadixTreePrinter;
 
 template <class T> class Node48 : public InnerNode<T> {
+  template <template <class> class> friend struct NodeLayout;
   friend class Node16<T>;
   friend class Node256<T>;
   friend class AdaptiveRadixTreePrinter<T>;
@@ -22,7 +23,7 @@ public:
   Node48();
   Node48(const Node48<T> &);
   Node48(const char *prefix) : InnerNode<T>{prefix} {
-    this->nodeType_ = NodeType::Node48;
+    this->setType(NodeType::Node48);
     std::fill(this->childIndex_, this->childIndex_ + CIMAX, (int8_t)-1);
     for (int i = 0; i < MAX; ++i)
       child_[i] = nullptr;
@@ -34,23 +35,45 @@ public:
   bool isFull() const override;
   bool isLack() const override;
   InnerNode<T> *grow() override;
+  InnerNode<T> *clone() const override;
   Node<T> *shrink() override;
   Node<T> *growChild(uint8_t byte) override;
   Node<T> *shrinkChild(uint8_t byte) override;
+  int getSize() const override;
+  int getCapacity() const override;
+  void releaseChildren() override;
+  Node<T> *nextChild(int &byte) override;
+  Node<T> *prevChild(int &byte) override;
+  typename InnerNode<T>::LookupSpan lookupSpan(uint8_t byte) const override;
 
 private:
   static constexpr int CIMAX = 256;
   static constexpr int MAX = 48;
   static constexpr int MIN = 17;
+  // in the first line, next to the header
+  uint8_t size_ = 0;
   // used to index into child_[]
   // -1 means key doesn't exist
   int8_t childIndex_[CIMAX];
   Node<T> *child_[MAX];
-  uint8_t size_ = 0;
 };
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+template <> struct NodeLayout<Node48> {
+  using N = Node48<void>;
+  // the leaf count of a Counted tree may push the keys past the line
+  using C = Node48<Counted<void>>;
+  static_assert(alignof(N) == CACHE_LINE && sizeof(N) % CACHE_LINE == 0 &&
+                    alignof(C) == CACHE_LINE && sizeof(C) % CACHE_LINE == 0,
+                "inner nodes fill whole cache lines");
+  static_assert(offsetof(N, childIndex_) < CACHE_LINE,
+                "the size and the index start in the first line");
+};
+#pragma GCC diagnostic pop
+
 template <class T> Node48<T>::Node48() {
-  this->nodeType_ = NodeType::Node48;
+  this->setType(NodeType::Node48);
   std::fill(this->childIndex_, this->childIndex_ + CIMAX, (int8_t)-1);
   for (int i = 0; i < MAX; ++i)
     child_[i] = nullptr;
@@ -58,18 +81,22 @@ template <class T> Node48<T>::Node48() {
 
 template <class T>
 Node48<T>::Node48(const Node48<T> &other) : InnerNode<T>{other.prefix_} {
-  this->nodeType_ = NodeType::Node48;
+  this->setType(NodeType::Node48);
+  this->setCount(other.getCount());
   this->size_ = other.size_;
   std::copy(other.childIndex_, other.childIndex_ + CIMAX, this->childIndex_);
   std::copy(other.child_, other.child_ + MAX, this->child_);
+  // the children are now shared with other
+  for (int i = 0; i < MAX; ++i) {
+    if (child_[i] != nullptr) {
+      child_[i]->retain();
+    }
+  }
 }
 
 template <class T> Node48<T>::~Node48() {
   for (int i = 0; i < MAX; ++i) {
-    if (child_[i] != nullptr) {
-      assert(false);
-    }
-    delete child_[i];
+    Node<T>::release(child_[i]);
   }
 }
 
@@ -102,20 +129,25 @@ template <class T> void Node48<T>::addChild(uint8_t byte, Node<T> *child) {
 }
 
 template <class T> void Node48<T>::deleteChild(uint8_t byte) {
-  assert(!isLack());
   if (childIndex_[byte] != -1) {
     child_[childIndex_[byte]] = nullptr;
     childIndex_[byte] = -1;
+    size_--;
   }
-  size_--;
 }
 
 template <class T> bool Node48<T>::isFull() const { return size_ == MAX; }
 
 template <class T> bool Node48<T>::isLack() const { return size_ < MIN; }
 
+template <class T> InnerNode<T> *Node48<T>::clone() const {
+  return new Node48<T>{*this};
+}
+
 template <class T> InnerNode<T> *Node48<T>::grow() {
+  countStat(growCounter(this->type()));
   Node256<T> *newNode = new Node256<T>{this->prefix_};
+  newNode->setCount(this->getCount());
   newNode->size_ = this->size_;
   uint8_t cnt = 0;
   for (int key = 0; key < CIMAX && cnt < size_; ++key) {
@@ -132,7 +164,9 @@ template <class T> InnerNode<T> *Node48<T>::grow() {
 }
 
 template <class T> Node<T> *Node48<T>::shrink() {
+  countStat(shrinkCounter(this->type()));
   Node16<T> *newNode = new Node16<T>{this->prefix_};
+  newNode->setCount(this->getCount());
   newNode->size_ = this->size_;
   uint8_t cnt = 0;
   for (int key = 0; key < CIMAX && cnt < this->size_; ++key) {
@@ -173,6 +207,42 @@ template <class T> Node<T> *Node48<T>::shrinkChild(uint8_t byte) {
   return nullptr;
 }
 
+template <class T> int Node48<T>::getSize() const { return size_; }
+
+template <class T> int Node48<T>::getCapacity() const { return MAX; }
+
+template <class T> void Node48<T>::releaseChildren() {
+  std::fill(childIndex_, childIndex_ + CIMAX, (int8_t)-1);
+  std::fill(child_, child_ + MAX, nullptr);
+  size_ = 0;
+}
+
+template <class T> Node<T> *Node48<T>::nextChild(int &byte) {
+  for (int key = std::max(byte, 0); key < CIMAX; ++key) {
+    if (childIndex_[key] >= 0) {
+      byte = key;
+      return child_[childIndex_[key]];
+    }
+  }
+  return nullptr;
+}
+
+template <class T> Node<T> *Node48<T>::prevChild(int &byte) {
+  for (int key = std::min(byte, CIMAX - 1); key >= 0; --key) {
+    if (childIndex_[key] >= 0) {
+      byte = key;
+      return child_[childIndex_[key]];
+    }
+  }
+  return nullptr;
+}
+
+template <class T>
+typename InnerNode<T>::LookupSpan Node48<T>::lookupSpan(uint8_t byte) const {
+  auto index = childIndex_[byte];
+  return {&childIndex_[byte], 1, index >= 0 ? &child_[index] : nullptr};
+}
+
 } // namespace art
 
 #endif
\ No newline at end of file
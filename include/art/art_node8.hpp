@@ -0,0 +1,254 @@
+#ifndef ART_NODE8_HPP
+#define ART_NODE8_HPP
+
+#include "art_inner_node.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace art {
+
+template <class T> class Node4;
+template <class T> class Node16;
+template <class T> class AdaptiveRadixTreePrinter;
+
+/**
+    @brief Inner node between Node4 and Node16, only used by node
+      policies that ask for it, the 8 sorted index keys fit in one
+      machine word and are searched all at once
+ */
+template <class T> class Node8 : public InnerNode<T> {
+  template <template <class> class> friend struct NodeLayout;
+  friend class AdaptiveRadixTreePrinter<T>;
+
+public:
+  Node8() {
+    this->setType(NodeType::Node8);
+    memset(key_, 0, sizeof(uint8_t) * MAX);
+    for (int i = 0; i < MAX; ++i)
+      child_[i] = nullptr;
+  };
+  Node8(const Node8<T> &);
+  Node8(const char *prefix) : InnerNode<T>(prefix) {
+    this->setType(NodeType::Node8);
+    memset(key_, 0, sizeof(uint8_t) * MAX);
+    for (int i = 0; i < MAX; ++i)
+      child_[i] = nullptr;
+  }
+  ~Node8();
+  Node<T> *findChild(uint8_t byte) override;
+  void addChild(uint8_t byte, Node<T> *child) override;
+  void deleteChild(uint8_t byte) override;
+  bool isFull() const override;
+  bool isLack() const override;
+  InnerNode<T> *grow() override;
+  InnerNode<T> *clone() const override;
+  Node<T> *shrink() override;
+  Node<T> *growChild(uint8_t byte) override;
+  Node<T> *shrinkChild(uint8_t byte) override;
+  int getSize() const override;
+  int getCapacity() const override;
+  void releaseChildren() override;
+  Node<T> *nextChild(int &byte) override;
+  Node<T> *prevChild(int &byte) override;
+  typename InnerNode<T>::LookupSpan lookupSpan(uint8_t byte) const override;
+
+private:
+  // index of the key equal to byte, size_ if not exist
+  int find(uint8_t byte) const;
+
+  static constexpr int MAX = 8;
+  static constexpr int MIN = 3;
+  uint8_t size_ = 0;
+  uint8_t key_[MAX];
+  Node<T> *child_[MAX];
+};
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+template <> struct NodeLayout<Node8> {
+  using N = Node8<void>;
+  // the leaf count of a Counted tree may push the keys past the line
+  using C = Node8<Counted<void>>;
+  static_assert(alignof(N) == CACHE_LINE && sizeof(N) % CACHE_LINE == 0 &&
+                    alignof(C) == CACHE_LINE && sizeof(C) % CACHE_LINE == 0,
+                "inner nodes fill whole cache lines");
+  static_assert(offsetof(N, key_) + N::MAX <= CACHE_LINE,
+                "the keys share the first line with the header");
+};
+#pragma GCC diagnostic pop
+
+template <class T>
+Node8<T>::Node8(const Node8<T> &other) : InnerNode<T>(other.prefix_) {
+  this->setType(NodeType::Node8);
+  this->setCount(other.getCount());
+  this->size_ = other.size_;
+  std::copy(other.key_, other.key_ + MAX, this->key_);
+  std::copy(other.child_, other.child_ + other.size_, this->child_);
+  // the children are now shared with other
+  for (int i = 0; i < size_; ++i) {
+    child_[i]->retain();
+  }
+}
+
+template <class T> Node8<T>::~Node8() {
+  for (int i = 0; i < size_; ++i) {
+    Node<T>::release(child_[i]);
+  }
+}
+
+template <class T> int Node8<T>::find(uint8_t byte) const {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  constexpr uint64_t ones = 0x0101010101010101ULL;
+  constexpr uint64_t highs = 0x8080808080808080ULL;
+  uint64_t keys;
+  std::memcpy(&keys, key_, sizeof(keys));
+  // a zero byte of x marks a match, the lowest marked byte is exact
+  uint64_t x = keys ^ (ones * byte);
+  uint64_t mask = (x - ones) & ~x & highs;
+  if (size_ < MAX) {
+    mask &= (1ULL << (8 * size_)) - 1;
+  }
+  return mask ? __builtin_ctzll(mask) / 8 : size_;
+#else
+  int index = 0;
+  while (index < size_ && key_[index] != byte) {
+    index++;
+  }
+  return index;
+#endif
+}
+
+template <class T> Node<T> *Node8<T>::findChild(uint8_t byte) {
+  int index = find(byte);
+  return index < size_ ? child_[index] : nullptr;
+}
+
+template <class T> void Node8<T>::addChild(uint8_t byte, Node<T> *child) {
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  if (index < size_ && key_[index] == byte) {
+    child_[index] = child;
+    return;
+  }
+  assert(!isFull());
+  // move [index, size_ - 1] back
+  size_t n = size_ - index;
+  std::memmove(key_ + index + 1, key_ + index, n);
+  std::memmove(child_ + index + 1, child_ + index, n * sizeof(Node<T> *));
+  key_[index] = byte;
+  child_[index] = child;
+  size_++;
+}
+
+template <class T> void Node8<T>::deleteChild(uint8_t byte) {
+  int index = find(byte);
+  if (index == size_) {
+    return;
+  }
+  // move [index + 1, size_ - 1] forword
+  size_t n = size_ - index - 1;
+  std::memmove(key_ + index, key_ + index + 1, n);
+  std::memmove(child_ + index, child_ + index + 1, n * sizeof(Node<T> *));
+  size_--;
+}
+
+template <class T> bool Node8<T>::isFull() const { return size_ == MAX; }
+
+template <class T> bool Node8<T>::isLack() const { return size_ < MIN; }
+
+template <class T> InnerNode<T> *Node8<T>::clone() const {
+  return new Node8<T>{*this};
+}
+
+template <class T> InnerNode<T> *Node8<T>::grow() {
+  countStat(growCounter(this->type()));
+  auto newNode = new Node16<T>{this->prefix_};
+  newNode->setCount(this->getCount());
+  for (int i = 0; i < size_; ++i) {
+    newNode->addChild(key_[i], child_[i]);
+  }
+  releaseChildren();
+  delete this;
+  return newNode;
+}
+
+template <class T> Node<T> *Node8<T>::shrink() {
+  countStat(shrinkCounter(this->type()));
+  assert(size_ <= 4);
+  auto newNode = new Node4<T>{this->prefix_};
+  newNode->setCount(this->getCount());
+  for (int i = 0; i < size_; ++i) {
+    newNode->addChild(key_[i], child_[i]);
+  }
+  releaseChildren();
+  delete this;
+  return newNode;
+}
+
+template <class T> Node<T> *Node8<T>::growChild(uint8_t byte) {
+  int index = find(byte);
+  if (index == size_) {
+    return nullptr;
+  }
+  assert(child_[index]->type() != NodeType::LeafNode);
+  assert(static_cast<InnerNode<T> *>(child_[index])->isFull());
+  child_[index] = static_cast<InnerNode<T> *>(child_[index])->grow();
+  return child_[index];
+}
+
+template <class T> Node<T> *Node8<T>::shrinkChild(uint8_t byte) {
+  int index = find(byte);
+  if (index == size_) {
+    return nullptr;
+  }
+  assert(child_[index]->type() != NodeType::LeafNode);
+  assert(static_cast<InnerNode<T> *>(child_[index])->isLack());
+  child_[index] = static_cast<InnerNode<T> *>(child_[index])->shrink();
+  return child_[index];
+}
+
+template <class T> int Node8<T>::getSize() const { return size_; }
+
+template <class T> int Node8<T>::getCapacity() const { return MAX; }
+
+template <class T> void Node8<T>::releaseChildren() {
+  std::fill(child_, child_ + MAX, nullptr);
+  size_ = 0;
+}
+
+template <class T> Node<T> *Node8<T>::nextChild(int &byte) {
+  if (byte > 255) {
+    return nullptr;
+  }
+  int index = std::lower_bound(key_, key_ + size_, byte) - key_;
+  if (index == size_) {
+    return nullptr;
+  }
+  byte = key_[index];
+  return child_[index];
+}
+
+template <class T> Node<T> *Node8<T>::prevChild(int &byte) {
+  if (byte < 0) {
+    return nullptr;
+  }
+  int index = std::upper_bound(key_, key_ + size_, byte) - key_;
+  if (index == 0) {
+    return nullptr;
+  }
+  byte = key_[index - 1];
+  return child_[index - 1];
+}
+
+template <class T>
+typename InnerNode<T>::LookupSpan Node8<T>::lookupSpan(uint8_t byte) const {
+  // all keys are loaded as one word
+  int index = find(byte);
+  return {key_, MAX, index < size_ ? &child_[index] : nullptr};
+}
+
+} // namespace art
+
+#endif
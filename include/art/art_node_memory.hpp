@@ -0,0 +1,362 @@
+#ifndef ART_NODE_MEMORY_HPP
+#define ART_NODE_MEMORY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace art {
+
+enum class HugePages {
+  // regular pages
+  NONE,
+  // ask the kernel to back the arenas with transparent huge pages
+  TRANSPARENT,
+  // pages from the reserved hugetlbfs pool, transparent ones if the
+  // pool is too small
+  EXPLICIT,
+};
+
+struct NodeMemoryOptions {
+  HugePages hugePages = HugePages::TRANSPARENT;
+  // one arena bound to each NUMA node, a thread allocates from the
+  // arena of the node it first allocated on, so pin threads
+  bool numaLocal = false;
+  // spread Node48 and Node256, the wide upper levels of a large tree,
+  // over all NUMA nodes so that no socket serves every lookup
+  bool interleaveUpper = false;
+  // address space reserved by each arena, only touched pages use memory
+  size_t reserve = size_t{1} << 34;
+};
+
+/**
+    @brief While one is alive, the arenas hand out blocks of the calling
+      thread past all earlier ones instead of reusing freed blocks,
+      so that nodes allocated in a row end up next to each other
+ */
+class FreshNodeScope {
+public:
+  FreshNodeScope() { active() = true; }
+  FreshNodeScope(const FreshNodeScope &) = delete;
+  FreshNodeScope &operator=(const FreshNodeScope &) = delete;
+  ~FreshNodeScope() { active() = false; }
+
+  static bool &active() {
+    thread_local bool fresh = false;
+    return fresh;
+  }
+};
+
+/**
+    @brief Node memory carved out of one large mapping, freed blocks
+      are kept in free lists per 16 byte size class and reused, cache
+      line aligned blocks in separate lists per 64 byte size class,
+      the mapping is never returned to the system
+ */
+class NodeArena {
+public:
+  // blocks larger than this come from the default heap
+  static constexpr size_t MAX_BLOCK = 4096;
+  static constexpr size_t GRANULE = 16;
+  // largest alignment handed out
+  static constexpr size_t LINE = 64;
+
+  NodeArena(const NodeMemoryOptions &options, int mode, uint64_t nodeMask);
+  NodeArena(const NodeArena &) = delete;
+  NodeArena &operator=(const NodeArena &) = delete;
+
+  // nullptr once the reserved space is used up
+  // @param[in] fresh don't reuse a freed block
+  void *allocate(size_t size, size_t align, bool fresh);
+  void deallocate(void *ptr, size_t size, size_t align);
+
+  bool owns(const void *ptr) const {
+    auto p = static_cast<const char *>(ptr);
+    return p >= base_ && p < end_;
+  }
+
+  // huge pages were granted, explicit or transparent
+  bool hugePages() const { return hugePages_; }
+
+private:
+  // free list of the blocks of a size and alignment
+  void *&freeList(size_t size, size_t align) {
+    return align > GRANULE ? lineFree_[(size - 1) / LINE]
+                           : free_[(size - 1) / GRANULE];
+  }
+
+  std::mutex mutex_;
+  char *base_ = nullptr;
+  char *top_ = nullptr;
+  char *end_ = nullptr;
+  bool hugePages_ = false;
+  // first free block of each size class, linked through the blocks
+  void *free_[MAX_BLOCK / GRANULE] = {};
+  void *lineFree_[MAX_BLOCK / LINE] = {};
+};
+
+/**
+    @brief The arenas nodes are currently allocated from, arenas of
+      earlier configurations stay registered until their nodes are
+      freed back to them
+ */
+class NodeMemory {
+public:
+  static constexpr int MAX_ARENAS = 64;
+  static constexpr size_t INTERLEAVE_BYTES = 512;
+  static constexpr int MAX_NUMA_NODES = 64;
+
+  // align 0 for the default alignment of new
+  void *allocate(size_t size, size_t align);
+  void deallocate(void *ptr, size_t size, size_t align);
+
+  void use(const NodeMemoryOptions &options);
+  void useDefault() { config_.store(nullptr, std::memory_order_release); }
+  bool active() const {
+    return config_.load(std::memory_order_acquire) != nullptr;
+  }
+
+  // NUMA nodes the system may have, 1 without NUMA
+  static int numaNodes();
+
+private:
+  // arenas new nodes come from, never changed once published
+  struct Config {
+    NodeArena *local[MAX_NUMA_NODES] = {};
+    int nodes = 1;
+    NodeArena *interleaved = nullptr;
+  };
+
+  // arena for the calling thread
+  static NodeArena *arena(const Config &config, size_t size);
+
+  // add arena to the registry searched on deallocation
+  NodeArena *adopt(NodeArena *arena);
+
+  std::mutex mutex_;
+  // nullptr while the default heap is in use
+  std::atomic<const Config *> config_{nullptr};
+  // every config ever used, threads may still read replaced ones
+  std::vector<std::unique_ptr<Config>> configs_;
+  std::atomic<int> count_{0};
+  std::atomic<NodeArena *> arenas_[MAX_ARENAS] = {};
+};
+
+// Linux memory policies, see mbind(2)
+constexpr int MPOL_DEFAULT_MODE = 0;
+constexpr int MPOL_BIND_MODE = 2;
+constexpr int MPOL_INTERLEAVE_MODE = 3;
+
+inline NodeArena::NodeArena(const NodeMemoryOptions &options, int mode,
+                            uint64_t nodeMask) {
+#ifdef __linux__
+  constexpr size_t HUGE_PAGE = size_t{2} << 20;
+  size_t reserve = (options.reserve + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+  void *base = MAP_FAILED;
+  if (options.hugePages == HugePages::EXPLICIT) {
+    // no MAP_NORESERVE, fail now rather than on a later page fault
+    base = mmap(nullptr, reserve, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugePages_ = base != MAP_FAILED;
+  }
+  if (base == MAP_FAILED) {
+    // over-allocate to align the arena to a huge page
+    base = mmap(nullptr, reserve + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto addr = reinterpret_cast<uintptr_t>(base) + HUGE_PAGE - 1;
+    base = reinterpret_cast<void *>(addr & ~(HUGE_PAGE - 1));
+    if (options.hugePages != HugePages::NONE) {
+      hugePages_ = madvise(base, reserve, MADV_HUGEPAGE) == 0;
+    }
+  }
+  if (mode != MPOL_DEFAULT_MODE) {
+    // only a hint, a kernel without NUMA support ignores it
+    syscall(SYS_mbind, base, reserve, mode, &nodeMask, 64, 0);
+  }
+  base_ = top_ = static_cast<char *>(base);
+  end_ = base_ + reserve;
+#else
+  (void)options, (void)mode, (void)nodeMask;
+  throw std::runtime_error("node arenas need Linux");
+#endif
+}
+
+inline void *NodeArena::allocate(size_t size, size_t align, bool fresh) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  void *&head = freeList(size, align);
+  if (void *block = head; block != nullptr && !fresh) {
+    head = *static_cast<void **>(block);
+    return block;
+  }
+  size_t unit = align > GRANULE ? LINE : GRANULE;
+  size_t bytes = (size + unit - 1) / unit * unit;
+  auto top = reinterpret_cast<uintptr_t>(top_);
+  char *block = top_ + ((top + unit - 1) / unit * unit - top);
+  if (block > end_ || static_cast<size_t>(end_ - block) < bytes) {
+    return nullptr;
+  }
+  if (block != top_) {
+    // the gap skipped for the alignment is a free block of its own
+    void *&gap = freeList(block - top_, GRANULE);
+    *reinterpret_cast<void **>(top_) = gap;
+    gap = top_;
+  }
+  top_ = block + bytes;
+  return block;
+}
+
+inline void NodeArena::deallocate(void *ptr, size_t size, size_t align) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  void *&head = freeList(size, align);
+  *static_cast<void **>(ptr) = head;
+  head = ptr;
+}
+
+inline int NodeMemory::numaNodes() {
+  // e.g. "0-1"
+  std::ifstream possible{"/sys/devices/system/node/possible"};
+  std::string range;
+  if (!(possible >> range)) {
+    return 1;
+  }
+  size_t dash = range.find_last_of("-,");
+  int last = std::stoi(dash == std::string::npos ? range
+                                                 : range.substr(dash + 1));
+  return std::min(last + 1, MAX_NUMA_NODES);
+}
+
+inline NodeArena *NodeMemory::adopt(NodeArena *arena) {
+  int index = count_.load(std::memory_order_relaxed);
+  if (index == MAX_ARENAS) {
+    delete arena;
+    throw std::runtime_error("too many node arenas");
+  }
+  arenas_[index].store(arena, std::memory_order_release);
+  count_.store(index + 1, std::memory_order_release);
+  return arena;
+}
+
+inline void NodeMemory::use(const NodeMemoryOptions &options) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto config = configs_.emplace_back(new Config).get();
+  config->nodes = options.numaLocal ? numaNodes() : 1;
+  int mode = options.numaLocal ? MPOL_BIND_MODE : MPOL_DEFAULT_MODE;
+  for (int node = 0; node < config->nodes; ++node) {
+    config->local[node] =
+        adopt(new NodeArena{options, mode, uint64_t{1} << node});
+  }
+  if (options.interleaveUpper) {
+    int nodes = numaNodes();
+    uint64_t all = nodes == 64 ? ~uint64_t{0} : (uint64_t{1} << nodes) - 1;
+    config->interleaved =
+        adopt(new NodeArena{options, MPOL_INTERLEAVE_MODE, all});
+  }
+  config_.store(config, std::memory_order_release);
+}
+
+inline NodeArena *NodeMemory::arena(const Config &config, size_t size) {
+  if (config.interleaved != nullptr && size >= INTERLEAVE_BYTES) {
+    return config.interleaved;
+  }
+  if (config.nodes == 1) {
+    return config.local[0];
+  }
+  thread_local int node = -1;
+  if (node < 0) {
+    node = 0;
+#ifdef __linux__
+    unsigned cpu = 0, numa = 0;
+    if (syscall(SYS_getcpu, &cpu, &numa, nullptr) == 0) {
+      node = static_cast<int>(numa);
+    }
+#endif
+  }
+  return config.local[node < config.nodes ? node : 0];
+}
+
+inline void *NodeMemory::allocate(size_t size, size_t align) {
+  const Config *config = config_.load(std::memory_order_acquire);
+  if (config != nullptr && size <= NodeArena::MAX_BLOCK &&
+      align <= NodeArena::LINE) {
+    bool fresh = FreshNodeScope::active();
+    if (void *block = arena(*config, size)->allocate(size, align, fresh)) {
+      return block;
+    }
+  }
+  if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    return ::operator new(size, std::align_val_t{align});
+  }
+  return ::operator new(size);
+}
+
+inline void NodeMemory::deallocate(void *ptr, size_t size, size_t align) {
+  if (size <= NodeArena::MAX_BLOCK) {
+    int count = count_.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+      NodeArena *arena = arenas_[i].load(std::memory_order_relaxed);
+      if (arena->owns(ptr)) {
+        arena->deallocate(ptr, size, align);
+        return;
+      }
+    }
+  }
+  if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    ::operator delete(ptr, std::align_val_t{align});
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
+inline NodeMemory &nodeMemory() {
+  // never destroyed, nodes may outlive static destructors
+  static NodeMemory *memory = new NodeMemory;
+  return *memory;
+}
+
+/**
+    @brief Allocate the nodes and keys of every tree created from now
+      on from huge page, NUMA aware arenas, the arenas are reserved
+      right away and never unmapped, so call this once at startup
+ */
+inline void useNodeMemory(const NodeMemoryOptions &options) {
+  nodeMemory().use(options);
+}
+
+// allocate new nodes from the default heap again
+inline void useDefaultNodeMemory() { nodeMemory().useDefault(); }
+
+// new nodes come from the arenas of useNodeMemory
+inline bool usingNodeMemory() { return nodeMemory().active(); }
+
+// memory of a node or a key, size and align are needed to free it again
+inline void *allocateNode(size_t size, size_t align = 0) {
+  return nodeMemory().allocate(size, align);
+}
+
+inline void freeNode(void *ptr, size_t size, size_t align = 0) {
+  if (ptr != nullptr) {
+    nodeMemory().deallocate(ptr, size, align);
+  }
+}
+
+} // namespace art
+
+#endif
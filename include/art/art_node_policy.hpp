@@ -0,0 +1,245 @@
+#ifndef ART_NODE_POLICY_HPP
+#define ART_NODE_POLICY_HPP
+
+#include "art_inner_node.hpp"
+#include "art_node16.hpp"
+#include "art_node256.hpp"
+#include "art_node32.hpp"
+#include "art_node4.hpp"
+#include "art_node48.hpp"
+#include "art_node8.hpp"
+#include <stdexcept>
+
+namespace art {
+
+/**
+    @brief Node policies pick the inner node types of an
+      AdaptiveRadixTree and when it moves between them,
+      they provide the following static constexpr members:
+        NodeType grown(NodeType type);   type a full node grows to
+        NodeType shrunk(NodeType type);  type an underfull node shrinks to
+        int shrinkBelow(NodeType type);  a node with fewer children is
+                                         underfull
+      every tree starts with Node4 and grows up to Node256, an
+      underfull Node4 is always merged into its only child
+ */
+
+/**
+    @brief The original node sizes, a node shrinks as soon as its
+      children fit in the smaller type, so that a node oscillating
+      around a boundary is reallocated on every insert and remove
+ */
+struct DefaultNodePolicy {
+  static constexpr NodeType grown(NodeType type) {
+    switch (type) {
+    case NodeType::Node4:
+      return NodeType::Node16;
+    case NodeType::Node8:
+      return NodeType::Node16;
+    case NodeType::Node16:
+      return NodeType::Node48;
+    case NodeType::Node32:
+      return NodeType::Node48;
+    default:
+      return NodeType::Node256;
+    }
+  }
+
+  static constexpr NodeType shrunk(NodeType type) {
+    switch (type) {
+    case NodeType::Node8:
+      return NodeType::Node4;
+    case NodeType::Node16:
+      return NodeType::Node4;
+    case NodeType::Node32:
+      return NodeType::Node16;
+    case NodeType::Node48:
+      return NodeType::Node16;
+    case NodeType::Node256:
+      return NodeType::Node48;
+    default:
+      return NodeType::Node4;
+    }
+  }
+
+  static constexpr int shrinkBelow(NodeType type) {
+    switch (type) {
+    case NodeType::Node8:
+      return 3;
+    case NodeType::Node16:
+      return 5;
+    case NodeType::Node32:
+      return 9;
+    case NodeType::Node48:
+      return 17;
+    case NodeType::Node256:
+      return 49;
+    default:
+      return 2;
+    }
+  }
+};
+
+/**
+    @brief The original node types, a shrunk node keeps room for
+      half of its capacity before it has to grow again
+ */
+struct HysteresisNodePolicy : DefaultNodePolicy {
+  static constexpr int shrinkBelow(NodeType type) {
+    switch (type) {
+    case NodeType::Node16:
+      return 3;
+    case NodeType::Node48:
+      return 9;
+    case NodeType::Node256:
+      return 25;
+    default:
+      return DefaultNodePolicy::shrinkBelow(type);
+    }
+  }
+};
+
+/**
+    @brief Node4, Node8, Node16, Node32, Node48 and Node256 with the
+      same gap, smaller steps waste less memory in mid-sized nodes
+      at the cost of more grows
+ */
+struct FineNodePolicy {
+  static constexpr NodeType grown(NodeType type) {
+    switch (type) {
+    case NodeType::Node4:
+      return NodeType::Node8;
+    case NodeType::Node8:
+      return NodeType::Node16;
+    case NodeType::Node16:
+      return NodeType::Node32;
+    case NodeType::Node32:
+      return NodeType::Node48;
+    default:
+      return NodeType::Node256;
+    }
+  }
+
+  static constexpr NodeType shrunk(NodeType type) {
+    switch (type) {
+    case NodeType::Node16:
+      return NodeType::Node8;
+    case NodeType::Node32:
+      return NodeType::Node16;
+    case NodeType::Node48:
+      return NodeType::Node32;
+    case NodeType::Node256:
+      return NodeType::Node48;
+    default:
+      return NodeType::Node4;
+    }
+  }
+
+  static constexpr int shrinkBelow(NodeType type) {
+    switch (type) {
+    case NodeType::Node8:
+      return 3;
+    case NodeType::Node16:
+      return 5;
+    case NodeType::Node32:
+      return 9;
+    case NodeType::Node48:
+      return 17;
+    case NodeType::Node256:
+      return 25;
+    default:
+      return 2;
+    }
+  }
+};
+
+// max number of children of an inner node type
+constexpr int nodeCapacity(NodeType type) {
+  switch (type) {
+  case NodeType::Node4:
+    return 4;
+  case NodeType::Node8:
+    return 8;
+  case NodeType::Node16:
+    return 16;
+  case NodeType::Node32:
+    return 32;
+  case NodeType::Node48:
+    return 48;
+  case NodeType::Node256:
+    return 256;
+  default:
+    return 0;
+  }
+}
+
+/**
+    @brief Check that the node types reachable from Node4 grow up to
+      Node256 and that an underfull node fits in the type it shrinks to
+ */
+template <class Policy> constexpr bool isValidNodePolicy() {
+  if (Policy::shrinkBelow(NodeType::Node4) != 2) {
+    return false;
+  }
+  NodeType type = NodeType::Node4;
+  while (type != NodeType::Node256) {
+    NodeType next = Policy::grown(type);
+    if (nodeCapacity(next) <= nodeCapacity(type)) {
+      return false;
+    }
+    type = next;
+    NodeType smaller = Policy::shrunk(type);
+    int below = Policy::shrinkBelow(type);
+    if (nodeCapacity(smaller) >= nodeCapacity(type) || below < 1 ||
+        below - 1 > nodeCapacity(smaller)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// empty inner node of the given type
+template <class T>
+InnerNode<T> *newInnerNode(NodeType type, const char *prefix) {
+  switch (type) {
+  case NodeType::Node4:
+    return new Node4<T>{prefix};
+  case NodeType::Node8:
+    return new Node8<T>{prefix};
+  case NodeType::Node16:
+    return new Node16<T>{prefix};
+  case NodeType::Node32:
+    return new Node32<T>{prefix};
+  case NodeType::Node48:
+    return new Node48<T>{prefix};
+  case NodeType::Node256:
+    return new Node256<T>{prefix};
+  default:
+    throw std::runtime_error("invalid node type");
+  }
+}
+
+/**
+    @brief Move the children of node to a new node of the given type,
+      node is freed
+    @return the new node
+ */
+template <class T>
+InnerNode<T> *convertNode(InnerNode<T> *node, NodeType type) {
+  bool grows = nodeCapacity(type) > nodeCapacity(node->type());
+  countStat(grows ? growCounter(node->type()) : shrinkCounter(node->type()));
+  InnerNode<T> *newNode = newInnerNode<T>(type, node->getPrefix());
+  newNode->setCount(node->getCount());
+  int byte = 0;
+  for (Node<T> *child = node->nextChild(byte); child != nullptr;
+       ++byte, child = node->nextChild(byte)) {
+    newNode->addChild(byte, child);
+  }
+  node->releaseChildren();
+  delete node;
+  return newNode;
+}
+
+} // namespace art
+
+#endif
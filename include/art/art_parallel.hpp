@@ -0,0 +1,143 @@
+#ifndef ART_PARALLEL_HPP
+#define ART_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Runs the tasks 0..n-1 on a number of threads, each thread
+      starts on a contiguous block of tasks and takes them front to
+      back, a thread that runs out steals the back half of the largest
+      block left to another, so neighbouring tasks mostly stay on one
+      thread and one large task doesn't hold up the rest
+ */
+class WorkStealingPool {
+public:
+  // threads 0 for one per hardware thread
+  explicit WorkStealingPool(unsigned threads = 0) : threads_(threads) {
+    if (threads_ == 0) {
+      threads_ = std::max(1U, std::thread::hardware_concurrency());
+    }
+  }
+
+  unsigned threads() const { return threads_; }
+
+  /**
+    @brief Call work(task) once for every task in [0, tasks), the
+      calling thread is one of the workers, returns once all are done
+    @note an exception thrown by work stops the tasks not started yet
+      and is rethrown here
+  */
+  template <class Work> void run(size_t tasks, Work work);
+
+private:
+  // tasks [begin, end) left to a worker, on a line of its own
+  struct alignas(64) Block {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  // next task of worker self, stealing if its block is empty,
+  // false once every task is taken
+  bool take(std::vector<Block> &blocks, size_t self,
+            std::atomic<size_t> &untaken, size_t &task);
+
+  unsigned threads_;
+};
+
+template <class Work> void WorkStealingPool::run(size_t tasks, Work work) {
+  size_t workers = std::min<size_t>(threads_, tasks);
+  if (workers <= 1) {
+    for (size_t task = 0; task < tasks; ++task) {
+      work(task);
+    }
+    return;
+  }
+  std::vector<Block> blocks(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    blocks[i].begin = tasks * i / workers;
+    blocks[i].end = tasks * (i + 1) / workers;
+  }
+  std::atomic<size_t> untaken{tasks};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto worker = [&](size_t self) {
+    size_t task = 0;
+    while (!failed.load(std::memory_order_relaxed) &&
+           take(blocks, self, untaken, task)) {
+      try {
+        work(task);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{errorMutex};
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(workers - 1);
+  for (size_t i = 1; i < workers; ++i) {
+    pool.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+inline bool WorkStealingPool::take(std::vector<Block> &blocks, size_t self,
+                                   std::atomic<size_t> &untaken,
+                                   size_t &task) {
+  Block &own = blocks[self];
+  while (untaken.load(std::memory_order_acquire) > 0) {
+    {
+      std::lock_guard<std::mutex> lock{own.mutex};
+      if (own.begin < own.end) {
+        task = own.begin++;
+        untaken.fetch_sub(1, std::memory_order_release);
+        return true;
+      }
+    }
+    size_t victim = self, most = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      std::lock_guard<std::mutex> lock{blocks[i].mutex};
+      size_t left = blocks[i].end - blocks[i].begin;
+      if (i != self && left > most) {
+        victim = i;
+        most = left;
+      }
+    }
+    if (victim == self) {
+      // the last tasks are moving between blocks, look again
+      std::this_thread::yield();
+      continue;
+    }
+    std::scoped_lock lock{own.mutex, blocks[victim].mutex};
+    Block &from = blocks[victim];
+    // the victim may have run some of its tasks meanwhile
+    size_t left = from.end - from.begin;
+    own.end = from.end;
+    own.begin = from.end - (left + 1) / 2;
+    from.end = own.begin;
+  }
+  return false;
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,874 @@
+#ifndef ART_PARTITIONED_HPP
+#define ART_PARTITIONED_HPP
+
+#include "art.hpp"
+#include "art_ring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace art {
+
+struct PartitionOptions {
+  // requests a partition's ring holds before senders wait
+  size_t ringCapacity = 4096;
+  // how often the boundaries are checked for skew, 0 to only
+  // rebalance on demand
+  std::chrono::milliseconds rebalanceInterval{100};
+  // rebalance once a partition holds this many times the mean, or
+  // the mean divided by this many times
+  double skew = 1.5;
+  // partitions with fewer keys are never rebalanced
+  size_t minKeys = 4096;
+  // initial boundaries, one less than there are partitions, strictly
+  // increasing, by default the first byte of the keys is split evenly
+  std::vector<std::string> splits;
+  // pin the worker of partition i to cpu i
+  bool pinThreads = false;
+};
+
+/**
+    @brief Adaptive Radix Tree split into key ranges, each owned by a
+      worker thread running a plain single-threaded tree, other threads
+      delegate operations through the lock-free MpscRing of the owner
+      and get the results through futures or callbacks, so writes scale
+      with the partitions without any node level synchronization,
+      neighbouring partitions hand keys over when they skew
+    @note operations on one key from one thread are applied in order
+      if each is waited for before the next one is sent, pipelined ones
+      only while no rebalance moves the key
+ */
+template <class T> class PartitionedAdaptiveRadixTree {
+public:
+  // called on the worker with the result and the value found, inserted
+  // or removed
+  using Callback = std::function<void(RC, const T &)>;
+  using Entries = std::vector<std::pair<std::string, T>>;
+
+  // partitions 0 for one per hardware thread, at most 256
+  explicit PartitionedAdaptiveRadixTree(unsigned partitions = 0,
+                                        PartitionOptions options = {});
+  PartitionedAdaptiveRadixTree(const PartitionedAdaptiveRadixTree &) = delete;
+  PartitionedAdaptiveRadixTree &
+  operator=(const PartitionedAdaptiveRadixTree &) = delete;
+  // waits for the operations sent before
+  ~PartitionedAdaptiveRadixTree();
+
+  void search(const char *key, Callback done);
+  void insert(const char *key, const T &value, Callback done);
+  void remove(const char *key, Callback done);
+
+  std::future<std::pair<RC, T>> search(const char *key);
+  std::future<RC> insert(const char *key, const T &value);
+  std::future<std::pair<RC, T>> remove(const char *key);
+
+  /**
+    @brief Get the keys in [lo, hi) in order, every partition scans its
+      part on its own worker, the parts are not one point in time
+    @param[in] lo inclusive lower bound, nullptr for no lower bound
+    @param[in] hi exclusive upper bound, nullptr for no upper bound
+  */
+  std::future<Entries> scan(const char *lo, const char *hi);
+
+  /**
+    @brief If a partition is skewed, move the boundary that is furthest
+      from splitting the keys evenly, the keys in between are handed
+      from one neighbour to the other, runs by itself every
+      rebalanceInterval
+    @return true if keys were moved
+  */
+  bool rebalance();
+
+  // number of keys, counted by the workers as they go
+  size_t size() const;
+
+  // number of keys of each partition, in key order
+  std::vector<size_t> partitionSizes() const;
+
+  unsigned partitions() const { return partitions_.size(); }
+
+private:
+  enum class Op : uint8_t {
+    SEARCH,
+    INSERT,
+    REMOVE,
+    SCAN,
+    // pick the boundary to give count keys to a neighbour
+    SPLIT,
+    // the range is about to be handed over, hold back its requests
+    EXPECT,
+    // give the range to the target partition
+    HANDOVER,
+    // the keys of the range handed over
+    TAKE,
+    FLUSH,
+    STOP,
+  };
+
+  // [lo, hi), no hi for no upper bound, "" is below every key
+  struct KeyRange {
+    std::string lo;
+    std::optional<std::string> hi;
+
+    bool contains(const std::string &key) const {
+      return key >= lo && (!hi || key < *hi);
+    }
+    bool empty() const { return hi && lo >= *hi; }
+  };
+
+  // the parts of a scan and the promise of the whole
+  struct ScanState {
+    std::mutex mutex;
+    // the start of each part and its entries
+    std::vector<std::pair<std::string, Entries>> parts;
+    // parts sent and not answered yet
+    std::atomic<size_t> outstanding{0};
+    std::promise<Entries> result;
+  };
+
+  struct Request {
+    Op op = Op::STOP;
+    // the key, or the lower bound of a range
+    std::string key;
+    std::optional<std::string> hi;
+    T value{};
+    Callback done;
+    std::shared_ptr<ScanState> scan;
+    Entries batch;
+    // SPLIT: the number of keys to give and whether the largest go
+    bool up = false;
+    size_t count = 0;
+    std::function<void(std::optional<std::string>)> split;
+    // HANDOVER: the receiving partition
+    size_t target = 0;
+    // FLUSH and TAKE: called once done
+    std::function<void()> ack;
+
+    KeyRange range() const { return {key, hi}; }
+  };
+
+  // boundaries between the partitions, replaced as a whole
+  struct Layout {
+    std::vector<std::string> splits;
+
+    size_t owner(const std::string &key) const {
+      return std::upper_bound(splits.begin(), splits.end(), key) -
+             splits.begin();
+    }
+    KeyRange range(size_t p) const {
+      KeyRange range;
+      if (p > 0) {
+        range.lo = splits[p - 1];
+      }
+      if (p < splits.size()) {
+        range.hi = splits[p];
+      }
+      return range;
+    }
+  };
+
+  struct Partition {
+    explicit Partition(size_t capacity) : ring(capacity) {}
+
+    MpscRing<Request> ring;
+    std::thread thread;
+    // the worker sleeps on it once its ring stays empty
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> sleeping{false};
+    alignas(64) std::atomic<size_t> size{0};
+
+    // used by the worker only
+    AdaptiveRadixTree<T> tree;
+    KeyRange owned;
+    // range being handed over to this partition, its requests wait
+    std::optional<KeyRange> pending;
+    std::vector<Request> deferred;
+    // requests for other partitions whose rings were full
+    std::deque<std::pair<size_t, Request>> outbox;
+    // FLUSH acks waiting for the outbox to empty
+    std::vector<std::function<void()>> flushed;
+    bool running = true;
+  };
+
+  // idle rounds a worker polls its ring before sleeping
+  static constexpr int SPIN = 64;
+  // the layout readers are counted on this many cache lines
+  static constexpr size_t READER_STRIPES = 16;
+
+  struct alignas(64) ReaderCount {
+    std::atomic<size_t> count{0};
+  };
+
+  static KeyRange intersect(const KeyRange &a, const KeyRange &b);
+
+  /**
+    @brief Call fn with the current layout, it stays alive until fn
+      returns, so fn must not wait for anything
+  */
+  template <class Fn> auto withLayout(Fn fn) const;
+
+  size_t owner(const std::string &key) const {
+    return withLayout([&key](const Layout &layout) {
+      return layout.owner(key);
+    });
+  }
+
+  // swap in layout, the old one is freed once no reader can hold it
+  void publish(std::unique_ptr<Layout> layout);
+
+  // wait until req is in the ring of partition p, for other threads
+  void send(size_t p, Request &req);
+
+  // from a worker, never waits so that two workers can't block each
+  // other, requests to p stay in order
+  void forward(Partition &self, size_t p, Request &&req);
+
+  // send the parts of range owned by each partition in layout
+  void sendScan(Partition *self, const KeyRange &range,
+                const std::shared_ptr<ScanState> &state);
+
+  // add a part of a scan, the last one fulfills the promise
+  static void finishScan(ScanState &state, std::string start,
+                         Entries entries);
+
+  void work(size_t p);
+  void dispatch(Partition &self, Request &&req);
+  void execute(Partition &self, Request &req);
+  void scanPart(Partition &self, Request &req);
+  void handOver(Partition &self, Request &req);
+  void take(Partition &self, Request &req);
+
+  std::vector<std::unique_ptr<Partition>> partitions_;
+  std::atomic<const Layout *> layout_{nullptr};
+  // owns layout_, changed only by publish
+  std::unique_ptr<Layout> current_;
+  // a reader is counted under the parity of the epoch it began in,
+  // publish moves on to the next epoch and waits out the last one
+  std::atomic<unsigned> epoch_{0};
+  mutable ReaderCount readers_[2][READER_STRIPES];
+  PartitionOptions options_;
+  // one rebalance at a time
+  std::mutex rebalanceMutex_;
+  std::thread monitor_;
+  std::mutex monitorMutex_;
+  std::condition_variable monitorWakeup_;
+  bool stopping_ = false;
+};
+
+template <class T>
+PartitionedAdaptiveRadixTree<T>::PartitionedAdaptiveRadixTree(
+    unsigned partitions, PartitionOptions options)
+    : options_(std::move(options)) {
+  if (partitions == 0) {
+    partitions = std::max(1U, std::thread::hardware_concurrency());
+  }
+  if (!options_.splits.empty()) {
+    partitions = options_.splits.size() + 1;
+  }
+  partitions = std::min(partitions, 256U);
+  auto layout = std::make_unique<Layout>();
+  layout->splits = options_.splits;
+  if (layout->splits.empty()) {
+    for (unsigned i = 1; i < partitions; ++i) {
+      layout->splits.emplace_back(1, static_cast<char>(256 * i / partitions));
+    }
+  }
+  for (unsigned p = 0; p < partitions; ++p) {
+    auto partition =
+        partitions_.emplace_back(new Partition{options_.ringCapacity}).get();
+    partition->owned = layout->range(p);
+  }
+  publish(std::move(layout));
+  for (unsigned p = 0; p < partitions; ++p) {
+    partitions_[p]->thread = std::thread([this, p] { work(p); });
+#ifdef __linux__
+    if (options_.pinThreads) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(p % CPU_SETSIZE, &cpus);
+      pthread_setaffinity_np(partitions_[p]->thread.native_handle(),
+                             sizeof(cpus), &cpus);
+    }
+#endif
+  }
+  if (options_.rebalanceInterval.count() > 0 && partitions > 1) {
+    monitor_ = std::thread([this] {
+      std::unique_lock<std::mutex> lock{monitorMutex_};
+      while (!monitorWakeup_.wait_for(lock, options_.rebalanceInterval,
+                                      [this] { return stopping_; })) {
+        lock.unlock();
+        rebalance();
+        lock.lock();
+      }
+    });
+  }
+}
+
+template <class T>
+PartitionedAdaptiveRadixTree<T>::~PartitionedAdaptiveRadixTree() {
+  if (monitor_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{monitorMutex_};
+      stopping_ = true;
+    }
+    monitorWakeup_.notify_one();
+    monitor_.join();
+  }
+  // requests forwarded between the workers are all sent once every
+  // worker has gone through what it held, only then stop them
+  std::vector<std::future<void>> flushed;
+  for (size_t p = 0; p < partitions_.size(); ++p) {
+    auto done = std::make_shared<std::promise<void>>();
+    flushed.push_back(done->get_future());
+    Request req;
+    req.op = Op::FLUSH;
+    req.ack = [done] { done->set_value(); };
+    send(p, req);
+  }
+  for (auto &future : flushed) {
+    future.wait();
+  }
+  for (size_t p = 0; p < partitions_.size(); ++p) {
+    Request req;
+    req.op = Op::STOP;
+    send(p, req);
+  }
+  for (auto &partition : partitions_) {
+    partition->thread.join();
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::search(const char *key,
+                                             Callback done) {
+  Request req;
+  req.op = Op::SEARCH;
+  req.key = key;
+  req.done = std::move(done);
+  send(owner(req.key), req);
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::insert(const char *key, const T &value,
+                                             Callback done) {
+  Request req;
+  req.op = Op::INSERT;
+  req.key = key;
+  req.value = value;
+  req.done = std::move(done);
+  send(owner(req.key), req);
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::remove(const char *key,
+                                             Callback done) {
+  Request req;
+  req.op = Op::REMOVE;
+  req.key = key;
+  req.done = std::move(done);
+  send(owner(req.key), req);
+}
+
+template <class T>
+std::future<std::pair<RC, T>>
+PartitionedAdaptiveRadixTree<T>::search(const char *key) {
+  auto result = std::make_shared<std::promise<std::pair<RC, T>>>();
+  auto future = result->get_future();
+  search(key, [result](RC rc, const T &value) {
+    result->set_value({rc, value});
+  });
+  return future;
+}
+
+template <class T>
+std::future<RC> PartitionedAdaptiveRadixTree<T>::insert(const char *key,
+                                                        const T &value) {
+  auto result = std::make_shared<std::promise<RC>>();
+  auto future = result->get_future();
+  insert(key, value, [result](RC rc, const T &) { result->set_value(rc); });
+  return future;
+}
+
+template <class T>
+std::future<std::pair<RC, T>>
+PartitionedAdaptiveRadixTree<T>::remove(const char *key) {
+  auto result = std::make_shared<std::promise<std::pair<RC, T>>>();
+  auto future = result->get_future();
+  remove(key, [result](RC rc, const T &value) {
+    result->set_value({rc, value});
+  });
+  return future;
+}
+
+template <class T>
+std::future<typename PartitionedAdaptiveRadixTree<T>::Entries>
+PartitionedAdaptiveRadixTree<T>::scan(const char *lo, const char *hi) {
+  auto state = std::make_shared<ScanState>();
+  auto future = state->result.get_future();
+  KeyRange range;
+  if (lo != nullptr) {
+    range.lo = lo;
+  }
+  if (hi != nullptr) {
+    range.hi = hi;
+  }
+  if (range.empty()) {
+    state->result.set_value({});
+    return future;
+  }
+  sendScan(nullptr, range, state);
+  return future;
+}
+
+template <class T> bool PartitionedAdaptiveRadixTree<T>::rebalance() {
+  std::lock_guard<std::mutex> lock{rebalanceMutex_};
+  std::vector<size_t> sizes = partitionSizes();
+  size_t total = 0, largest = 0, smallest = SIZE_MAX;
+  for (size_t size : sizes) {
+    total += size;
+    largest = std::max(largest, size);
+    smallest = std::min(smallest, size);
+  }
+  double mean = static_cast<double>(total) / sizes.size();
+  if (largest < options_.minKeys ||
+      (largest <= options_.skew * mean && smallest * options_.skew >= mean)) {
+    return false;
+  }
+  // the boundary with the most keys on the wrong side of it
+  size_t left = 0, count = 0, before = 0;
+  bool up = false;
+  for (size_t i = 0; i + 1 < sizes.size(); ++i) {
+    before += sizes[i];
+    size_t even = total * (i + 1) / sizes.size();
+    size_t wrong = before > even ? before - even : even - before;
+    if (wrong > count) {
+      left = i;
+      count = wrong;
+      up = before > even;
+    }
+  }
+  size_t donor = up ? left : left + 1;
+  size_t receiver = up ? left + 1 : left;
+  // the donor keeps at least one key for the boundary
+  count = std::min(count, sizes[donor] > 0 ? sizes[donor] - 1 : 0);
+  if (count == 0) {
+    return false;
+  }
+
+  // the donor picks the boundary among its keys
+  std::promise<std::optional<std::string>> picked;
+  Request req;
+  req.op = Op::SPLIT;
+  req.up = up;
+  req.count = count;
+  req.split = [&picked](std::optional<std::string> key) {
+    picked.set_value(std::move(key));
+  };
+  send(donor, req);
+  std::optional<std::string> boundary = picked.get_future().get();
+  if (!boundary) {
+    return false;
+  }
+  // only rebalance replaces the layout, it reads it without counting
+  const Layout &old = *current_;
+  KeyRange moved = old.range(donor);
+  if (up) {
+    moved.lo = *boundary;
+  } else {
+    moved.hi = *boundary;
+  }
+
+  // the receiver holds back the range before anyone can send it there
+  req = Request{};
+  req.op = Op::EXPECT;
+  req.key = moved.lo;
+  req.hi = moved.hi;
+  send(receiver, req);
+  auto layout = std::make_unique<Layout>(old);
+  layout->splits[left] = *boundary;
+  publish(std::move(layout));
+
+  std::promise<void> taken;
+  req = Request{};
+  req.op = Op::HANDOVER;
+  req.key = moved.lo;
+  req.hi = moved.hi;
+  req.target = receiver;
+  req.ack = [&taken] { taken.set_value(); };
+  send(donor, req);
+  taken.get_future().wait();
+  return true;
+}
+
+template <class T> size_t PartitionedAdaptiveRadixTree<T>::size() const {
+  size_t total = 0;
+  for (auto &partition : partitions_) {
+    total += partition->size.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+template <class T>
+std::vector<size_t> PartitionedAdaptiveRadixTree<T>::partitionSizes() const {
+  std::vector<size_t> sizes;
+  for (auto &partition : partitions_) {
+    sizes.push_back(partition->size.load(std::memory_order_relaxed));
+  }
+  return sizes;
+}
+
+template <class T>
+typename PartitionedAdaptiveRadixTree<T>::KeyRange
+PartitionedAdaptiveRadixTree<T>::intersect(const KeyRange &a,
+                                           const KeyRange &b) {
+  KeyRange range{std::max(a.lo, b.lo), a.hi};
+  if (!a.hi || (b.hi && *b.hi < *a.hi)) {
+    range.hi = b.hi;
+  }
+  return range;
+}
+
+template <class T>
+template <class Fn>
+auto PartitionedAdaptiveRadixTree<T>::withLayout(Fn fn) const {
+  thread_local size_t stripe =
+      std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+      READER_STRIPES;
+  // counted before the layout is loaded, publish either sees the count
+  // or the reader sees the new layout
+  std::atomic<size_t> &count =
+      readers_[epoch_.load(std::memory_order_seq_cst) & 1][stripe].count;
+  count.fetch_add(1, std::memory_order_seq_cst);
+  auto result = fn(*layout_.load(std::memory_order_seq_cst));
+  count.fetch_sub(1, std::memory_order_release);
+  return result;
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::publish(std::unique_ptr<Layout> layout) {
+  layout_.store(layout.get(), std::memory_order_seq_cst);
+  std::swap(current_, layout);
+  if (layout == nullptr) {
+    return;
+  }
+  // readers that may still hold the old layout began in the last epoch
+  unsigned last = epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+  for (ReaderCount &readers : readers_[last]) {
+    while (readers.count.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::send(size_t p, Request &req) {
+  Partition &partition = *partitions_[p];
+  while (!partition.ring.tryPush(req)) {
+    std::this_thread::yield();
+  }
+  // pairs with the fence of a worker going to sleep, either it sees
+  // the request or this sees it sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (partition.sleeping.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock{partition.mutex};
+    partition.wakeup.notify_one();
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::forward(Partition &self, size_t p,
+                                              Request &&req) {
+  if (self.outbox.empty() && partitions_[p]->ring.tryPush(req)) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (partitions_[p]->sleeping.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock{partitions_[p]->mutex};
+      partitions_[p]->wakeup.notify_one();
+    }
+    return;
+  }
+  self.outbox.emplace_back(p, std::move(req));
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::sendScan(
+    Partition *self, const KeyRange &range,
+    const std::shared_ptr<ScanState> &state) {
+  auto parts = withLayout([this, &range](const Layout &current) {
+    std::vector<std::pair<size_t, KeyRange>> parts;
+    for (size_t p = current.owner(range.lo); p < partitions_.size(); ++p) {
+      KeyRange part = intersect(range, current.range(p));
+      if (part.empty()) {
+        break;
+      }
+      parts.emplace_back(p, std::move(part));
+    }
+    return parts;
+  });
+  // counted before any is sent, so no answer completes the scan early
+  state->outstanding.fetch_add(parts.size(), std::memory_order_relaxed);
+  for (auto &[p, part] : parts) {
+    Request req;
+    req.op = Op::SCAN;
+    req.key = std::move(part.lo);
+    req.hi = std::move(part.hi);
+    req.scan = state;
+    if (self != nullptr) {
+      forward(*self, p, std::move(req));
+    } else {
+      send(p, req);
+    }
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::finishScan(ScanState &state,
+                                                 std::string start,
+                                                 Entries entries) {
+  {
+    std::lock_guard<std::mutex> lock{state.mutex};
+    state.parts.emplace_back(std::move(start), std::move(entries));
+  }
+  if (state.outstanding.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  std::sort(state.parts.begin(), state.parts.end(),
+            [](auto &a, auto &b) { return a.first < b.first; });
+  Entries all;
+  for (auto &[start, part] : state.parts) {
+    for (auto &entry : part) {
+      // a key scanned on both sides of a handover is kept once
+      if (all.empty() || entry.first > all.back().first) {
+        all.push_back(std::move(entry));
+      }
+    }
+  }
+  state.result.set_value(std::move(all));
+}
+
+template <class T> void PartitionedAdaptiveRadixTree<T>::work(size_t p) {
+  Partition &self = *partitions_[p];
+  Request req;
+  int idle = 0;
+  while (self.running) {
+    while (!self.outbox.empty()) {
+      auto &[target, waiting] = self.outbox.front();
+      if (!partitions_[target]->ring.tryPush(waiting)) {
+        break;
+      }
+      self.outbox.pop_front();
+    }
+    if (self.outbox.empty() && !self.flushed.empty()) {
+      for (auto &ack : self.flushed) {
+        ack();
+      }
+      self.flushed.clear();
+    }
+    if (self.ring.tryPop(req)) {
+      dispatch(self, std::move(req));
+      idle = 0;
+      continue;
+    }
+    if (++idle < SPIN || !self.outbox.empty()) {
+      std::this_thread::yield();
+      continue;
+    }
+    self.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+      std::unique_lock<std::mutex> lock{self.mutex};
+      // the timeout only guards against a missed notify
+      self.wakeup.wait_for(lock, std::chrono::milliseconds{10},
+                           [&self] { return !self.ring.empty(); });
+    }
+    self.sleeping.store(false, std::memory_order_relaxed);
+    idle = 0;
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::dispatch(Partition &self,
+                                               Request &&req) {
+  switch (req.op) {
+  case Op::SEARCH:
+  case Op::INSERT:
+  case Op::REMOVE:
+    if (self.pending && self.pending->contains(req.key)) {
+      self.deferred.push_back(std::move(req));
+    } else if (!self.owned.contains(req.key)) {
+      // sent by the layout before a rebalance
+      forward(self, owner(req.key), std::move(req));
+    } else {
+      execute(self, req);
+    }
+    break;
+  case Op::SCAN:
+    if (self.pending && !intersect(*self.pending, req.range()).empty()) {
+      self.deferred.push_back(std::move(req));
+    } else {
+      scanPart(self, req);
+    }
+    break;
+  case Op::SPLIT: {
+    size_t size = self.size.load(std::memory_order_relaxed);
+    std::optional<std::string> boundary;
+    if (req.count > 0 && req.count < size) {
+      // the first key given, or the first key kept
+      size_t index = req.up ? size - req.count : req.count;
+      auto it = self.tree.begin();
+      for (size_t i = 0; i < index && it.valid(); ++i) {
+        it.next();
+      }
+      if (it.valid()) {
+        boundary = it.getKey();
+      }
+    }
+    req.split(std::move(boundary));
+    break;
+  }
+  case Op::EXPECT:
+    self.pending = req.range();
+    break;
+  case Op::HANDOVER:
+    handOver(self, req);
+    break;
+  case Op::TAKE:
+    take(self, req);
+    break;
+  case Op::FLUSH:
+    // done once everything forwarded before is in the other rings
+    self.flushed.push_back(std::move(req.ack));
+    break;
+  case Op::STOP:
+    self.running = false;
+    break;
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::execute(Partition &self,
+                                              Request &req) {
+  RC rc = RC::SUCCESS;
+  switch (req.op) {
+  case Op::SEARCH:
+    rc = self.tree.search(req.key.c_str(), req.value);
+    break;
+  case Op::INSERT: {
+    bool added = false;
+    rc = self.tree.insert(req.key.c_str(), req.value, added);
+    if (added) {
+      self.size.store(self.size.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    }
+    break;
+  }
+  case Op::REMOVE:
+    rc = self.tree.remove(req.key.c_str(), req.value);
+    if (rc == RC::SUCCESS) {
+      self.size.store(self.size.load(std::memory_order_relaxed) - 1,
+                      std::memory_order_relaxed);
+    }
+    break;
+  default:
+    break;
+  }
+  if (req.done) {
+    req.done(rc, req.value);
+  }
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::scanPart(Partition &self,
+                                               Request &req) {
+  KeyRange range = req.range();
+  KeyRange own = intersect(range, self.owned);
+  Entries entries;
+  if (!own.empty()) {
+    auto cursor = self.tree.cursor();
+    cursor.seek(own.lo.c_str());
+    for (; cursor.valid() && (!own.hi || *own.hi > cursor.getKey());
+         cursor.next()) {
+      entries.emplace_back(cursor.getKey(), cursor.getValue());
+    }
+  }
+  // parts handed to a neighbour since the scan was sent go after it
+  if (range.lo < self.owned.lo) {
+    KeyRange below{range.lo, self.owned.lo};
+    sendScan(&self, intersect(below, range), req.scan);
+  }
+  if (self.owned.hi && (!range.hi || *self.owned.hi < *range.hi)) {
+    KeyRange above{*self.owned.hi, range.hi};
+    sendScan(&self, intersect(above, range), req.scan);
+  }
+  finishScan(*req.scan, own.empty() ? range.lo : own.lo, std::move(entries));
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::handOver(Partition &self,
+                                               Request &req) {
+  KeyRange range = req.range();
+  Request give;
+  give.op = Op::TAKE;
+  give.key = range.lo;
+  give.hi = range.hi;
+  give.ack = std::move(req.ack);
+  auto cursor = self.tree.cursor();
+  cursor.seek(range.lo.c_str());
+  for (; cursor.valid() && (!range.hi || *range.hi > cursor.getKey());
+       cursor.next()) {
+    give.batch.emplace_back(cursor.getKey(), cursor.getValue());
+  }
+  self.tree.eraseRange(range.lo.c_str(),
+                       range.hi ? range.hi->c_str() : nullptr);
+  self.size.store(self.size.load(std::memory_order_relaxed) -
+                      give.batch.size(),
+                  std::memory_order_relaxed);
+  if (range.lo == self.owned.lo) {
+    self.owned.lo = *range.hi;
+  } else {
+    self.owned.hi = range.lo;
+  }
+  forward(self, req.target, std::move(give));
+}
+
+template <class T>
+void PartitionedAdaptiveRadixTree<T>::take(Partition &self, Request &req) {
+  self.tree.insertSorted(req.batch.begin(), req.batch.end());
+  self.size.store(self.size.load(std::memory_order_relaxed) +
+                      req.batch.size(),
+                  std::memory_order_relaxed);
+  if (self.owned.hi && req.key == *self.owned.hi) {
+    self.owned.hi = req.hi;
+  } else {
+    self.owned.lo = req.key;
+  }
+  self.pending.reset();
+  req.ack();
+  // the requests held back, in the order they came
+  std::vector<Request> deferred;
+  deferred.swap(self.deferred);
+  for (auto &waiting : deferred) {
+    dispatch(self, std::move(waiting));
+  }
+}
+
+} // namespace art
+
+#endif
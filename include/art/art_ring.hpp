@@ -0,0 +1,103 @@
+#ifndef ART_RING_HPP
+#define ART_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Bounded lock-free ring with many producers and one consumer,
+      every slot carries a sequence number telling whether it is free
+      for the producer holding a ticket or filled for the consumer,
+      producers only contend on the ticket counter, the order of the
+      tickets is the order elements are popped in
+ */
+template <class E> class MpscRing {
+public:
+  // capacity is rounded up to a power of 2
+  explicit MpscRing(size_t capacity) : slots_(roundUp(capacity)) {
+    mask_ = slots_.size() - 1;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  MpscRing(const MpscRing &) = delete;
+  MpscRing &operator=(const MpscRing &) = delete;
+
+  // move e in unless the ring is full, e is left alone then
+  bool tryPush(E &e);
+
+  // consumer only, move the oldest element out unless the ring is empty
+  bool tryPop(E &e);
+
+  // consumer only
+  bool empty() const {
+    const Slot &slot = slots_[head_ & mask_];
+    return slot.seq.load(std::memory_order_acquire) != head_ + 1;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    E value;
+  };
+
+  static size_t roundUp(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  std::vector<Slot> slots_;
+  size_t mask_;
+  // next ticket of a producer and next slot of the consumer,
+  // on lines of their own
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) size_t head_ = 0;
+};
+
+template <class E> bool MpscRing<E>::tryPush(E &e) {
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  Slot *slot;
+  while (true) {
+    slot = &slots_[pos & mask_];
+    size_t seq = slot->seq.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // the consumer hasn't freed the slot of the previous round
+      return false;
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->value = std::move(e);
+  slot->seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <class E> bool MpscRing<E>::tryPop(E &e) {
+  Slot &slot = slots_[head_ & mask_];
+  if (slot.seq.load(std::memory_order_acquire) != head_ + 1) {
+    return false;
+  }
+  e = std::move(slot.value);
+  // free for the producer of the next round
+  slot.seq.store(head_ + mask_ + 1, std::memory_order_release);
+  head_++;
+  return true;
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef ART_STATS_HPP
+#define ART_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace art {
+
+// count hot path events per thread, compiled out without ART_STATS
+#ifdef ART_STATS
+constexpr bool STATS = true;
+#else
+constexpr bool STATS = false;
+#endif
+
+enum class NodeType : uint8_t;
+
+// number of NodeType values
+constexpr int NODE_TYPES = 8;
+
+/**
+    @brief Counted events, grows and shrinks are further split by the
+      type of the node that grows or shrinks
+ */
+enum class Counter : int {
+  SEARCHES,
+  SEARCH_NODES,
+  INSERTS,
+  INSERT_NODES,
+  REMOVES,
+  REMOVE_NODES,
+  // bytes compared against inner node prefixes
+  PREFIX_BYTES,
+  // bytes compared against full keys in leaves
+  KEY_MATCH_BYTES,
+  NODE16_SIMD,
+  NODE16_SCALAR,
+  // inner nodes split on a prefix mismatch by insert
+  PREFIX_SPLITS,
+  LEAF_ALLOCS,
+  GROWS,
+  SHRINKS = GROWS + NODE_TYPES,
+  COUNT = SHRINKS + NODE_TYPES,
+};
+
+inline Counter growCounter(NodeType type) {
+  return static_cast<Counter>(static_cast<int>(Counter::GROWS) +
+                              static_cast<int>(type));
+}
+
+inline Counter shrinkCounter(NodeType type) {
+  return static_cast<Counter>(static_cast<int>(Counter::SHRINKS) +
+                              static_cast<int>(type));
+}
+
+/**
+    @brief Counters summed over all threads
+ */
+struct Stats {
+  uint64_t get(Counter counter) const {
+    return value[static_cast<int>(counter)];
+  }
+
+  // calls fn(name, value) for every counter, names are dotted paths
+  template <class Fn> void forEach(Fn fn) const;
+
+  uint64_t value[static_cast<int>(Counter::COUNT)] = {};
+};
+
+template <class Fn> void Stats::forEach(Fn fn) const {
+  static const char *const names[] = {
+      "search.count",     "search.nodes",       "insert.count",
+      "insert.nodes",     "remove.count",       "remove.nodes",
+      "compare.prefix",   "compare.key",        "node16.simd",
+      "node16.scalar",    "insert.split",       "leaf.alloc",
+  };
+  static const char *const types[NODE_TYPES] = {
+      "invalid", "leaf", "node4", "node8", "node16", "node32", "node48",
+      "node256"};
+  static_assert(sizeof(names) / sizeof(names[0]) ==
+                static_cast<int>(Counter::GROWS));
+  int i = 0;
+  for (auto name : names) {
+    fn(std::string{name}, value[i++]);
+  }
+  for (auto type : types) {
+    fn("grow." + std::string{type}, value[i++]);
+  }
+  for (auto type : types) {
+    fn("shrink." + std::string{type}, value[i++]);
+  }
+}
+
+// counters of one thread, only written by that thread
+struct ThreadStats {
+  ThreadStats();
+  ~ThreadStats();
+
+  std::atomic<uint64_t> value[static_cast<int>(Counter::COUNT)] = {};
+};
+
+/**
+    @brief All live thread counters and the sums of the exited threads
+ */
+class StatsRegistry {
+public:
+  Stats collect() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    Stats stats = retired_;
+    for (auto thread : threads_) {
+      add(stats, *thread);
+    }
+    return stats;
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    retired_ = Stats{};
+    for (auto thread : threads_) {
+      for (auto &value : thread->value) {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void join(ThreadStats *thread) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    threads_.push_back(thread);
+  }
+
+  void leave(ThreadStats *thread) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    add(retired_, *thread);
+    threads_.erase(std::find(threads_.begin(), threads_.end(), thread));
+  }
+
+  std::function<void(const std::string &, uint64_t)> hook;
+
+private:
+  static void add(Stats &stats, const ThreadStats &thread) {
+    for (int i = 0; i < static_cast<int>(Counter::COUNT); ++i) {
+      stats.value[i] += thread.value[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<ThreadStats *> threads_;
+  Stats retired_;
+};
+
+inline StatsRegistry &statsRegistry() {
+  static StatsRegistry registry;
+  return registry;
+}
+
+inline ThreadStats::ThreadStats() { statsRegistry().join(this); }
+
+inline ThreadStats::~ThreadStats() { statsRegistry().leave(this); }
+
+// add n to a counter of the calling thread
+inline void countStat(Counter counter, uint64_t n = 1) {
+  if constexpr (STATS) {
+    thread_local ThreadStats stats;
+    auto &value = stats.value[static_cast<int>(counter)];
+    // only this thread writes, no read-modify-write needed
+    value.store(value.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+  }
+}
+
+// counters summed over all threads, exact once writers are quiet
+inline Stats collectStats() { return statsRegistry().collect(); }
+
+inline void resetStats() { statsRegistry().reset(); }
+
+/**
+    @brief Set the hook exportStats feeds, e.g. a metrics pipeline
+    @param[in] hook called as hook(name, value) for every counter
+ */
+inline void
+setStatsExportHook(std::function<void(const std::string &, uint64_t)> hook) {
+  statsRegistry().hook = std::move(hook);
+}
+
+// pass the current counters to the export hook, if any
+inline void exportStats() {
+  auto &hook = statsRegistry().hook;
+  if (hook) {
+    collectStats().forEach(hook);
+  }
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef ART_VALUE_LOG_HPP
+#define ART_VALUE_LOG_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace art {
+
+/**
+    @brief Append-only log of values addressed by integer handles,
+      values live in fixed size arena chunks and never move until the
+      log is replaced, a discarded value is destroyed at once but its
+      slot is only reclaimed by copying the live values to a new log
+ */
+template <class T, class Handle = uint32_t> class ValueLog {
+  static_assert(std::is_integral_v<Handle> && std::is_unsigned_v<Handle>,
+                "handles are unsigned integers");
+
+public:
+  ValueLog() = default;
+  ValueLog(const ValueLog &) = delete;
+  ValueLog(ValueLog &&other) noexcept { *this = std::move(other); }
+  ValueLog &operator=(const ValueLog &) = delete;
+  ValueLog &operator=(ValueLog &&other) noexcept {
+    if (this != &other) {
+      clear();
+      chunks_ = std::move(other.chunks_);
+      live_ = std::move(other.live_);
+      liveCount_ = std::exchange(other.liveCount_, 0);
+      other.chunks_.clear();
+      other.live_.clear();
+    }
+    return *this;
+  }
+  ~ValueLog() { clear(); }
+
+  // store a copy of value at the end of the log
+  Handle append(const T &value) { return emplace(value); }
+  Handle append(T &&value) { return emplace(std::move(value)); }
+
+  // the value of a handle that has not been discarded
+  const T &get(Handle handle) const { return *slot(handle); }
+  T &get(Handle handle) { return *slot(handle); }
+
+  // destroy the value, its slot stays until the log is compacted
+  void discard(Handle handle);
+
+  // number of values ever appended
+  size_t size() const { return live_.size(); }
+
+  // number of values not discarded
+  size_t live() const { return liveCount_; }
+
+  // number of discarded values still taking space
+  size_t garbage() const { return size() - live(); }
+
+  // bytes held by the arena chunks
+  size_t bytes() const { return chunks_.size() * CHUNK * sizeof(Slot); }
+
+  // destroy all values and free the arena
+  void clear();
+
+private:
+  // values per arena chunk, about 64KB each
+  static constexpr size_t CHUNK =
+      std::max<size_t>(1, (size_t{1} << 16) / sizeof(T));
+
+  struct Slot {
+    alignas(T) unsigned char data[sizeof(T)];
+  };
+
+  template <class V> Handle emplace(V &&value);
+
+  T *slot(Handle handle) const {
+    return std::launder(reinterpret_cast<T *>(
+        chunks_[handle / CHUNK][handle % CHUNK].data));
+  }
+
+  std::vector<std::unique_ptr<Slot[]>> chunks_;
+  // one flag per appended value, false once discarded
+  std::vector<bool> live_;
+  size_t liveCount_ = 0;
+};
+
+template <class T, class Handle>
+template <class V>
+Handle ValueLog<T, Handle>::emplace(V &&value) {
+  size_t index = live_.size();
+  if (index > std::numeric_limits<Handle>::max()) {
+    throw std::runtime_error("value log is full, compact it");
+  }
+  if (index == chunks_.size() * CHUNK) {
+    chunks_.emplace_back(new Slot[CHUNK]);
+  }
+  auto handle = static_cast<Handle>(index);
+  new (chunks_[index / CHUNK][index % CHUNK].data) T(std::forward<V>(value));
+  live_.push_back(true);
+  liveCount_++;
+  return handle;
+}
+
+template <class T, class Handle>
+void ValueLog<T, Handle>::discard(Handle handle) {
+  if (!live_[handle]) {
+    return;
+  }
+  slot(handle)->~T();
+  live_[handle] = false;
+  liveCount_--;
+}
+
+template <class T, class Handle> void ValueLog<T, Handle>::clear() {
+  for (size_t i = 0; i < live_.size(); ++i) {
+    if (live_[i]) {
+      slot(static_cast<Handle>(i))->~T();
+    }
+  }
+  chunks_.clear();
+  live_.clear();
+  liveCount_ = 0;
+}
+
+} // namespace art
+
+#endif
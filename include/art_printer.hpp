@@ -11,12 +11,15 @@
 #include <string>
 #include <sys/types.h>
 #include <system_error>
+#include <type_traits>
 
 namespace art {
 
-template <class T> class AdaptiveRadixTree;
+template <class T, class NodePolicy> class AdaptiveRadixTree;
 template <class T> class Node4;
+template <class T> class Node8;
 template <class T> class Node16;
+template <class T> class Node32;
 template <class T> class Node48;
 template <class T> class Node256;
 
@@ -26,7 +29,8 @@ public:
    * @brief do a dfs of the tree and print it
    * @param[out] os holds the printable format of the tree
    */
-  void draw(const AdaptiveRadixTree<T> *tree, std::ostream &os) {
+  template <class NodePolicy>
+  void draw(const AdaptiveRadixTree<T, NodePolicy> *tree, std::ostream &os) {
     if (tree == nullptr || tree->root_ == nullptr) {
       os << "Empty Tree\n";
       return;
@@ -47,8 +51,12 @@ public:
 
   void printLeaf(std::ostream &os, const LeafNode<T> *node, int level) {
     os << "@LeafNode ";
-    os << "<" << std::string(node->getPrefix()) << ", " << node->getValue()
-       << ">\n";
+    if constexpr (std::is_void_v<T>) {
+      os << "<" << std::string(node->getPrefix()) << ">\n";
+    } else {
+      os << "<" << std::string(node->getPrefix()) << ", " << node->getValue()
+         << ">\n";
+    }
   }
 
   void printNode4(std::ostream &os, const Node4<T> *node, int level) {
@@ -68,6 +76,23 @@ public:
     }
   }
 
+  void printNode8(std::ostream &os, const Node8<T> *node, int level) {
+    os << "&Node8 {";
+    if (node->getPrefixLen() > 0) {
+      os << std::string(node->getPrefix());
+    }
+    os << "}\n";
+    uint8_t sz = node->size_;
+    for (int i = 0; i < sz; ++i) {
+      for (int j = 0; j < level; ++j) {
+        os << "  ";
+      }
+      int val = static_cast<int>(node->key_[i]);
+      printKey(os, val);
+      printNode(os, node->child_[i], level + 1);
+    }
+  }
+
   void printNode16(std::ostream &os, const Node16<T> *node, int level) {
     os << "$Node16 {";
     if (node->getPrefixLen() > 0) {
@@ -85,6 +110,23 @@ public:
     }
   }
 
+  void printNode32(std::ostream &os, const Node32<T> *node, int level) {
+    os << "*Node32 {";
+    if (node->getPrefixLen() > 0) {
+      os << std::string(node->getPrefix());
+    }
+    os << "}\n";
+    uint8_t sz = node->size_;
+    for (int i = 0; i < sz; ++i) {
+      for (int j = 0; j < level; ++j) {
+        os << "  ";
+      }
+      int val = static_cast<int>(node->key_[i]);
+      printKey(os, val);
+      printNode(os, node->child_[i], level + 1);
+    }
+  }
+
   void printNode48(std::ostream &os, const Node48<T> *node, int level) {
     os << "%Node48 {";
     if (node->getPrefixLen() > 0) {
@@ -128,9 +170,15 @@ public:
     case NodeType::Node4: {
       printNode4(os, static_cast<const Node4<T> *>(node), level);
     } break;
+    case NodeType::Node8: {
+      printNode8(os, static_cast<const Node8<T> *>(node), level);
+    } break;
     case NodeType::Node16: {
       printNode16(os, static_cast<const Node16<T> *>(node), level);
     } break;
+    case NodeType::Node32: {
+      printNode32(os, static_cast<const Node32<T> *>(node), level);
+    } break;
     case NodeType::Node48: {
       printNode48(os, static_cast<const Node48<T> *>(node), level);
     } break;
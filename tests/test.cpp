@@ -3,19 +3,37 @@
 #include "art/art_node.hpp"
 #include "art_printer.hpp"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <random>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <sys/types.h>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+#ifdef TEST_COUNTED
+// test_order_statistics runs the tests that check the leaf counts on
+// trees of Counted values
+using TestInt = art::Counted<int>;
+using TestVoid = art::Counted<void>;
+#else
+using TestInt = int;
+using TestVoid = void;
+#endif
 
 // TEST(NodeTest, DISABLED_GrowShrink) {
 //   constexpr int KEYRANGE = 256;
@@ -240,4 +258,1762 @@ TEST(TreeTest, DeleteTest) {
     EXPECT_EQ(ret, art::RC::SUCCESS);
     EXPECT_EQ(v, val);
   }
-}
\ No newline at end of file
+}
+
+TEST(TreeTest, IteratorTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+  std::mt19937 gen(42);
+  // include bytes >= 0x80 so the order of Node16 keys is checked as well
+  std::uniform_int_distribution<int> bdis(1, 255);
+  std::uniform_int_distribution<int> ldis(1, 6);
+
+  for (int i = 0; i < 20000; ++i) {
+    std::string key;
+    int len = ldis(gen);
+    for (int j = 0; j < len; ++j) {
+      key.push_back(static_cast<char>(bdis(gen)));
+    }
+    kvs[key] = i;
+    tree.insert(key.c_str(), i);
+  }
+
+  auto iter = tree.begin();
+  for (auto &[k, v] : kvs) {
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    EXPECT_EQ(iter.getValue(), v);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+}
+
+TEST(SetTest, InsertEraseIterate) {
+  art::AdaptiveRadixTree<void> set;
+  std::set<std::string> keys;
+  std::mt19937 gen(7);
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    EXPECT_EQ(set.insert(line.c_str()), art::RC::SUCCESS);
+    keys.insert(line);
+  }
+  // inserting again is a no-op
+  EXPECT_EQ(set.insert(keys.begin()->c_str()), art::RC::SUCCESS);
+
+  std::vector<std::string> erased;
+  for (auto iter = keys.begin(); iter != keys.end();) {
+    if (gen() % 2) {
+      EXPECT_EQ(set.erase(iter->c_str()), art::RC::SUCCESS);
+      erased.push_back(*iter);
+      iter = keys.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  for (auto &k : erased) {
+    EXPECT_FALSE(set.contains(k.c_str()));
+    EXPECT_EQ(set.erase(k.c_str()), art::RC::KEY_NOT_EXIST);
+  }
+  auto iter = set.begin();
+  for (auto &k : keys) {
+    EXPECT_TRUE(set.contains(k.c_str()));
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+}
+
+TEST(SetTest, TreeFeatures) {
+  // a set runs on the map's code, node policies and versions included
+  art::AdaptiveRadixTree<TestVoid, art::FineNodePolicy> set;
+  std::set<std::string> keys;
+  for (int i = 0; i < 5000; ++i) {
+    std::string key = "k" + std::to_string(i * 7919 % 10007);
+    EXPECT_EQ(set.insert(key.c_str()), art::RC::SUCCESS);
+    keys.insert(key);
+  }
+  auto version = set.snapshot();
+  set.setLazyRemove(true);
+  std::vector<std::string> erased;
+  for (auto it = keys.begin(); it != keys.end();) {
+    if (erased.size() * 2 < keys.size()) {
+      EXPECT_EQ(set.erase(it->c_str()), art::RC::SUCCESS);
+      EXPECT_FALSE(set.contains(it->c_str()));
+      erased.push_back(*it);
+      it = keys.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  EXPECT_EQ(set.purge(), erased.size());
+#ifdef TEST_COUNTED
+  EXPECT_EQ(set.size(), keys.size());
+  EXPECT_EQ(version.size(), keys.size() + erased.size());
+#endif
+  auto iter = set.begin();
+  for (auto &k : keys) {
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+  for (auto &k : erased) {
+    EXPECT_TRUE(version.contains(k.c_str()));
+  }
+
+  size_t budget = set.memoryUsage() / 2;
+  set.setMemoryBudget(budget);
+  EXPECT_LE(set.memoryUsage(), budget);
+  EXPECT_EQ(set.snapshot().memoryUsage(), set.memoryUsage());
+}
+
+TEST(TreeTest, MergeTest) {
+  art::AdaptiveRadixTree<int> tree;
+  art::AdaptiveRadixTree<int> delta;
+  std::map<std::string, int> kvs;
+  std::mt19937 gen(11);
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    int v = ++i;
+    switch (gen() % 4) {
+    case 0:
+      tree.insert(line.c_str(), v);
+      kvs[line] = v;
+      break;
+    case 1:
+      delta.insert(line.c_str(), v);
+      kvs[line] = v;
+      break;
+    case 2:
+      // present in both trees, conflict resolved by the policy
+      tree.insert(line.c_str(), v);
+      delta.insert(line.c_str(), -v);
+      kvs[line] = 0;
+      break;
+    default:;
+    }
+  }
+
+  auto policy = [](const char *, const int &mine, const int &theirs) {
+    return mine + theirs;
+  };
+  EXPECT_EQ(tree.merge(std::move(delta), policy), art::RC::SUCCESS);
+  EXPECT_FALSE(delta.begin().valid());
+
+  int val = 0;
+  auto iter = tree.begin();
+  for (auto &[k, v] : kvs) {
+    EXPECT_EQ(tree.search(k.c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, v);
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+
+  // merged nodes must still support removal
+  for (auto &[k, v] : kvs) {
+    EXPECT_EQ(tree.remove(k.c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, v);
+  }
+  EXPECT_FALSE(tree.begin().valid());
+}
+
+TEST(TreeTest, PrefixTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    kvs[line] = ++i;
+    tree.insert(line.c_str(), i);
+  }
+
+  auto hasPrefix = [](const std::string &key, const std::string &prefix) {
+    return key.compare(0, prefix.size(), prefix) == 0;
+  };
+
+  // extract prefixes ending inside a node prefix, at a node and at a leaf
+  for (std::string prefix : {"ab", "cont", "zymu", "zzz", "a"}) {
+    auto subtree = tree.extractPrefix(prefix.c_str());
+    auto iter = subtree.begin();
+    for (auto it = kvs.begin(); it != kvs.end();) {
+      if (hasPrefix(it->first, prefix)) {
+        ASSERT_TRUE(iter.valid());
+        EXPECT_EQ(std::string(iter.getKey()), it->first);
+        EXPECT_EQ(iter.getValue(), it->second);
+        iter.next();
+        it = kvs.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    EXPECT_FALSE(iter.valid());
+  }
+
+  EXPECT_EQ(tree.erasePrefix("b"), art::RC::SUCCESS);
+  EXPECT_EQ(tree.erasePrefix("b"), art::RC::KEY_NOT_EXIST);
+  // the second waits for the first subtree to be freed
+  EXPECT_EQ(tree.erasePrefix("c", true), art::RC::SUCCESS);
+  EXPECT_EQ(tree.erasePrefix("d", true), art::RC::SUCCESS);
+  for (auto it = kvs.begin(); it != kvs.end();) {
+    bool erased = hasPrefix(it->first, "b") || hasPrefix(it->first, "c") ||
+                  hasPrefix(it->first, "d");
+    it = erased ? kvs.erase(it) : std::next(it);
+  }
+
+  int val = 0;
+  auto iter = tree.begin();
+  for (auto &[k, v] : kvs) {
+    EXPECT_EQ(tree.search(k.c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, v);
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+
+  // the whole tree
+  auto all = tree.extractPrefix("");
+  EXPECT_FALSE(tree.begin().valid());
+  EXPECT_TRUE(all.begin().valid());
+}
+
+TEST(TreeTest, RangeDeleteTest) {
+  std::map<std::string, int> kvs;
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    // a sample of the words keeps the test fast
+    if (++i % 5 == 0) {
+      kvs[line] = i;
+    }
+  }
+
+  std::vector<std::pair<const char *, const char *>> ranges = {
+      {"b", "c"},        {"abs", "absurd"}, {"con", "cont"},
+      {"m", "ma"},       {"x", nullptr},    {nullptr, "ab"},
+      {"qu", "qu"},      {"zzz", "zzzz"},   {"dog", "dogs"},
+      {nullptr, nullptr}};
+  for (auto &[lo, hi] : ranges) {
+    art::AdaptiveRadixTree<int> tree;
+    for (auto &[k, v] : kvs) {
+      tree.insert(k.c_str(), v);
+    }
+    std::map<std::string, int> rest;
+    size_t expected = 0;
+    for (auto &[k, v] : kvs) {
+      if ((lo == nullptr || k >= lo) && (hi == nullptr || k < hi)) {
+        expected++;
+      } else {
+        rest[k] = v;
+      }
+    }
+
+    EXPECT_EQ(tree.eraseRange(lo, hi), expected);
+    int val = 0;
+    auto iter = tree.begin();
+    for (auto &[k, v] : rest) {
+      EXPECT_EQ(tree.search(k.c_str(), val), art::RC::SUCCESS);
+      EXPECT_EQ(val, v);
+      ASSERT_TRUE(iter.valid());
+      EXPECT_EQ(std::string(iter.getKey()), k);
+      iter.next();
+    }
+    EXPECT_FALSE(iter.valid());
+    // the tree stays consistent for point deletes
+    for (auto &[k, v] : rest) {
+      EXPECT_EQ(tree.remove(k.c_str(), val), art::RC::SUCCESS);
+    }
+  }
+}
+
+TEST(TreeTest, OrderStatisticsTest) {
+  art::AdaptiveRadixTree<art::Counted<int>> tree;
+  art::AdaptiveRadixTree<art::Counted<int>> delta;
+  std::map<std::string, int> kvs;
+  std::mt19937 gen(5);
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    if (++i % 3 != 0) {
+      continue;
+    }
+    kvs[line] = i;
+    if (gen() % 2) {
+      tree.insert(line.c_str(), i);
+    } else {
+      delta.insert(line.c_str(), i);
+    }
+  }
+  // updates must not change the counts
+  tree.insert(kvs.begin()->first.c_str(), kvs.begin()->second);
+  tree.merge(std::move(delta),
+             [](const char *, const int &, const int &v) { return v; });
+
+  int val = 0;
+  for (auto iter = kvs.begin(); iter != kvs.end();) {
+    switch (gen() % 8) {
+    case 0:
+      EXPECT_EQ(tree.remove(iter->first.c_str(), val), art::RC::SUCCESS);
+      iter = kvs.erase(iter);
+      break;
+    case 1:
+      EXPECT_EQ(tree.remove((iter->first + "#").c_str(), val),
+                art::RC::KEY_NOT_EXIST);
+      ++iter;
+      break;
+    default:
+      ++iter;
+    }
+  }
+  tree.extractPrefix("ca");
+  tree.eraseRange("pre", "pro");
+  for (auto iter = kvs.begin(); iter != kvs.end();) {
+    bool gone = iter->first.compare(0, 2, "ca") == 0 ||
+                (iter->first >= "pre" && iter->first < "pro");
+    iter = gone ? kvs.erase(iter) : std::next(iter);
+  }
+
+  std::vector<std::string> keys;
+  for (auto &[k, v] : kvs) {
+    keys.push_back(k);
+  }
+  ASSERT_EQ(tree.size(), keys.size());
+  std::string key;
+  for (size_t k = 0; k < keys.size(); k += 97) {
+    EXPECT_EQ(tree.rank(keys[k].c_str()), k);
+    EXPECT_EQ(tree.select(k, key, val), art::RC::SUCCESS);
+    EXPECT_EQ(key, keys[k]);
+    EXPECT_EQ(val, kvs[keys[k]]);
+  }
+  EXPECT_EQ(tree.select(keys.size(), key, val), art::RC::KEY_NOT_EXIST);
+
+  for (std::string probe : {"", "a", "cat", "m", "mz", "pre", "zzzz"}) {
+    size_t expected =
+        std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin();
+    EXPECT_EQ(tree.rank(probe.c_str()), expected);
+  }
+  auto lo = std::lower_bound(keys.begin(), keys.end(), "dog");
+  auto hi = std::lower_bound(keys.begin(), keys.end(), "moon");
+  EXPECT_EQ(tree.countRange("dog", "moon"), hi - lo);
+  EXPECT_EQ(tree.countRange("moon", "dog"), 0);
+  EXPECT_EQ(tree.countRange(nullptr, nullptr), keys.size());
+
+  // only the trees of Counted values pay for the counts
+  static_assert(!art::AdaptiveRadixTree<int>::ORDER_STATISTICS);
+  EXPECT_EQ(sizeof(art::Node4<int>), art::CACHE_LINE);
+  EXPECT_GT(sizeof(art::Node4<art::Counted<int>>), art::CACHE_LINE);
+}
+
+TEST(TreeTest, LongestPrefixMatchTest) {
+  art::AdaptiveRadixTree<int> tree;
+  int val = 0;
+  EXPECT_EQ(tree.longestPrefixMatch("/", val), art::RC::KEY_NOT_EXIST);
+
+  std::vector<std::string> routes = {"/",          "/api",      "/api/v1",
+                                     "/api/v1/users", "/api/v2", "/static/",
+                                     "10.",        "10.1.",     "10.1.2.",
+                                     "10.2.",      "192.168."};
+  for (size_t i = 0; i < routes.size(); ++i) {
+    tree.insert(routes[i].c_str(), i);
+  }
+
+  auto expectMatch = [&](const char *query, const char *route) {
+    int value = -1;
+    art::RC ret = tree.longestPrefixMatch(query, value);
+    if (route == nullptr) {
+      EXPECT_EQ(ret, art::RC::KEY_NOT_EXIST) << query;
+      return;
+    }
+    auto iter = std::find(routes.begin(), routes.end(), route);
+    EXPECT_EQ(ret, art::RC::SUCCESS) << query;
+    EXPECT_EQ(value, iter - routes.begin()) << query;
+  };
+  expectMatch("/", "/");
+  expectMatch("/index.html", "/");
+  expectMatch("/ap", "/");
+  expectMatch("/api", "/api");
+  expectMatch("/api/", "/api");
+  expectMatch("/api/v1/users/42", "/api/v1/users");
+  expectMatch("/api/v1/user", "/api/v1");
+  expectMatch("/api/v3", "/api");
+  expectMatch("/static/css/a.css", "/static/");
+  expectMatch("/static", "/");
+  expectMatch("10.1.2.3", "10.1.2.");
+  expectMatch("10.1.3.4", "10.1.");
+  expectMatch("10.3.0.1", "10.");
+  expectMatch("192.168.0.1", "192.168.");
+  expectMatch("192.169.0.1", nullptr);
+  expectMatch("1", nullptr);
+  expectMatch("", nullptr);
+
+  // a single leaf as root
+  art::AdaptiveRadixTree<int> single;
+  single.insert("abc", 1);
+  EXPECT_EQ(single.longestPrefixMatch("abcd", val), art::RC::SUCCESS);
+  EXPECT_EQ(single.longestPrefixMatch("ab", val), art::RC::KEY_NOT_EXIST);
+}
+
+TEST(TreeTest, AutomatonTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    kvs[line] = ++i;
+    tree.insert(line.c_str(), i);
+  }
+
+  auto editDistance = [](const std::string &a, const std::string &b) {
+    std::vector<int> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+      row[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+      int diag = row[0];
+      row[0] = i;
+      for (size_t j = 1; j <= b.size(); ++j) {
+        int up = row[j];
+        row[j] = std::min({row[j] + 1, row[j - 1] + 1,
+                           diag + (a[i - 1] == b[j - 1] ? 0 : 1)});
+        diag = up;
+      }
+    }
+    return row[b.size()];
+  };
+
+  for (auto &[word, dist] : std::vector<std::pair<std::string, int>>{
+           {"hello", 1}, {"tree", 2}, {"x", 1}, {"", 1}}) {
+    std::vector<std::string> expected;
+    for (auto &[k, v] : kvs) {
+      if (editDistance(k, word) <= dist) {
+        expected.push_back(k);
+      }
+    }
+    std::vector<std::string> found;
+    tree.traverse(art::LevenshteinAutomaton{word, dist},
+                  [&](const char *key, const int &value) {
+                    EXPECT_EQ(value, kvs[key]);
+                    found.push_back(key);
+                  });
+    EXPECT_EQ(found, expected) << word;
+  }
+
+  // reference glob matcher on whole strings
+  std::function<bool(const char *, const char *)> glob =
+      [&](const char *p, const char *s) -> bool {
+    if (*p == '\0') {
+      return *s == '\0';
+    }
+    if (*p == '*') {
+      return glob(p + 1, s) || (*s != '\0' && glob(p, s + 1));
+    }
+    return *s != '\0' && (*p == '?' || *p == *s) && glob(p + 1, s + 1);
+  };
+  for (std::string pattern : {"ab*tion", "?oo?", "*zz*", "c*t", "qu?ck"}) {
+    std::vector<std::string> expected;
+    for (auto &[k, v] : kvs) {
+      if (glob(pattern.c_str(), k.c_str())) {
+        expected.push_back(k);
+      }
+    }
+    std::vector<std::string> found;
+    tree.traverse(art::GlobAutomaton{pattern},
+                  [&](const char *key, const int &) { found.push_back(key); });
+    EXPECT_EQ(found, expected) << pattern;
+  }
+}
+
+TEST(TreeTest, SnapshotTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+  std::mt19937 gen(17);
+  auto randomKey = [&gen]() {
+    std::string key(1 + gen() % 6, 'a');
+    for (auto &c : key) {
+      c = 'a' + gen() % 4;
+    }
+    return key;
+  };
+  auto expectSame = [](art::AdaptiveRadixTree<int> &t,
+                       const std::map<std::string, int> &m) {
+    auto iter = t.begin();
+    for (auto &[k, v] : m) {
+      ASSERT_TRUE(iter.valid());
+      EXPECT_EQ(std::string(iter.getKey()), k);
+      EXPECT_EQ(iter.getValue(), v);
+      iter.next();
+    }
+    EXPECT_FALSE(iter.valid());
+  };
+
+  // every version must keep its content whatever happens to the others
+  std::vector<std::pair<art::AdaptiveRadixTree<int>, std::map<std::string, int>>>
+      versions;
+  int val = 0;
+  for (int round = 0; round < 40; ++round) {
+    versions.emplace_back(tree.snapshot(), kvs);
+    for (int i = 0; i < 200; ++i) {
+      std::string key = randomKey();
+      if (gen() % 3 == 0) {
+        EXPECT_EQ(tree.remove(key.c_str(), val) == art::RC::SUCCESS,
+                  kvs.erase(key) == 1);
+      } else {
+        tree.insert(key.c_str(), round * 1000 + i);
+        kvs[key] = round * 1000 + i;
+      }
+    }
+    // bulk writes copy paths as well
+    switch (round % 4) {
+    case 0: {
+      std::string lo = randomKey(), hi = randomKey();
+      tree.eraseRange(lo.c_str(), hi.c_str());
+      if (lo < hi) {
+        kvs.erase(kvs.lower_bound(lo), kvs.lower_bound(hi));
+      }
+      break;
+    }
+    case 1: {
+      std::string prefix = randomKey().substr(0, 2);
+      tree.erasePrefix(prefix.c_str());
+      for (auto it = kvs.lower_bound(prefix);
+           it != kvs.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+        it = kvs.erase(it);
+      }
+      break;
+    }
+    case 2: {
+      // merge a tree whose nodes are shared with its own snapshot
+      art::AdaptiveRadixTree<int> delta;
+      for (int i = 0; i < 50; ++i) {
+        delta.insert(randomKey().c_str(), -i);
+      }
+      auto deltaVersion = delta.snapshot();
+      for (auto iter = deltaVersion.begin(); iter.valid(); iter.next()) {
+        kvs[iter.getKey()] += iter.getValue();
+      }
+      tree.merge(std::move(delta),
+                 [](const char *, const int &mine, const int &theirs) {
+                   return mine + theirs;
+                 });
+      // a version may be written too, it forks from the tree
+      auto &[fork, forkKvs] = versions[gen() % versions.size()];
+      for (auto iter = deltaVersion.begin(); iter.valid(); iter.next()) {
+        fork.insert(iter.getKey(), 7);
+        forkKvs[iter.getKey()] = 7;
+      }
+      break;
+    }
+    default:
+      // drop a version, its private nodes are freed
+      versions.erase(versions.begin() + gen() % versions.size());
+    }
+  }
+
+  expectSame(tree, kvs);
+  for (auto &[version, versionKvs] : versions) {
+    expectSame(version, versionKvs);
+  }
+
+  // readers scan a snapshot while the tree keeps changing
+  auto version = tree.snapshot();
+  std::thread reader([&version, &kvs, &expectSame] {
+    for (int i = 0; i < 20; ++i) {
+      expectSame(version, kvs);
+    }
+  });
+  auto later = kvs;
+  for (auto &[k, v] : later) {
+    EXPECT_EQ(tree.remove(k.c_str(), val), art::RC::SUCCESS);
+  }
+  reader.join();
+  EXPECT_FALSE(tree.begin().valid());
+  expectSame(version, kvs);
+}
+
+TEST(TreeTest, InsertSortedTest) {
+  art::AdaptiveRadixTree<TestInt> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  std::vector<std::pair<std::string, int>> batch;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    batch.emplace_back(line, ++i);
+  }
+  std::sort(batch.begin(), batch.end());
+  // existing keys are updated, keys in between are added
+  for (size_t j = 0; j < batch.size(); j += 3) {
+    tree.insert(batch[j].first.c_str(), -1);
+  }
+  EXPECT_EQ(tree.insertSorted(batch.begin(), batch.end()), art::RC::SUCCESS);
+  for (auto &[k, v] : batch) {
+    kvs[k] = v;
+  }
+
+  // the order only matters for speed
+  std::mt19937 gen(23);
+  std::vector<std::pair<const char *, int>> shuffled;
+  for (size_t j = 0; j < batch.size(); j += 7) {
+    shuffled.emplace_back(batch[j].first.c_str(), -batch[j].second);
+    kvs[batch[j].first] = -batch[j].second;
+  }
+  std::shuffle(shuffled.begin(), shuffled.end(), gen);
+  tree.insertSorted(shuffled.begin(), shuffled.end());
+
+  int val = 0;
+  auto iter = tree.begin();
+  for (auto &[k, v] : kvs) {
+    EXPECT_EQ(tree.search(k.c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, v);
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+#ifdef TEST_COUNTED
+  EXPECT_EQ(tree.size(), kvs.size());
+  EXPECT_EQ(tree.rank(kvs.rbegin()->first.c_str()), kvs.size() - 1);
+#endif
+}
+
+TEST(TreeTest, CursorTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    if (++i % 2 == 0) {
+      tree.insert(line.c_str(), i);
+      kvs[line] = i;
+    }
+  }
+
+  std::vector<std::string> keys;
+  for (auto &kv : kvs) {
+    keys.push_back(kv.first);
+  }
+  std::mt19937 gen(29);
+  auto cursor = tree.cursor();
+  EXPECT_FALSE(cursor.valid());
+  auto expectAt = [&](std::map<std::string, int>::iterator it) {
+    if (it == kvs.end()) {
+      EXPECT_FALSE(cursor.valid());
+      return;
+    }
+    ASSERT_TRUE(cursor.valid());
+    EXPECT_EQ(std::string(cursor.getKey()), it->first);
+    EXPECT_EQ(cursor.getValue(), it->second);
+  };
+  for (int round = 0; round < 2000; ++round) {
+    // stored keys, keys in between and neighbours of the last seek
+    std::string key = keys[gen() % keys.size()];
+    switch (gen() % 3) {
+    case 0:
+      key.back() = 'a' + gen() % 26;
+      break;
+    case 1:
+      key += static_cast<char>('a' + gen() % 26);
+      break;
+    default:;
+    }
+    auto it = kvs.lower_bound(key);
+    EXPECT_EQ(cursor.seek(key.c_str()), it != kvs.end() && it->first == key);
+    expectAt(it);
+    if (!cursor.valid()) {
+      continue;
+    }
+    int steps = gen() % 5;
+    for (int j = 0; j < steps && it != kvs.end(); ++j) {
+      cursor.next();
+      expectAt(++it);
+    }
+    for (int j = 0; j < steps && cursor.valid(); ++j) {
+      cursor.prev();
+      expectAt(it == kvs.begin() ? kvs.end() : --it);
+    }
+  }
+
+  // walk the whole tree backwards
+  cursor.seek(kvs.rbegin()->first.c_str());
+  for (auto it = kvs.rbegin(); it != kvs.rend(); ++it) {
+    ASSERT_TRUE(cursor.valid());
+    EXPECT_EQ(std::string(cursor.getKey()), it->first);
+    cursor.prev();
+  }
+  EXPECT_FALSE(cursor.valid());
+  EXPECT_FALSE(cursor.seek("\x7f\x7f"));
+  EXPECT_FALSE(cursor.valid());
+}
+
+TEST(TreeTest, BufferedTreeTest) {
+  art::BufferedAdaptiveRadixTree<int> tree{64};
+  std::map<std::string, int> kvs;
+  std::mt19937 gen(31);
+  auto randomKey = [&gen]() {
+    std::string key(1 + gen() % 8, 'a');
+    for (auto &c : key) {
+      c = 'a' + gen() % 8;
+    }
+    return key;
+  };
+
+  int val = 0;
+  for (int i = 0; i < 50000; ++i) {
+    std::string key = randomKey();
+    switch (gen() % 4) {
+    case 0: {
+      auto it = kvs.find(key);
+      EXPECT_EQ(tree.remove(key.c_str(), val) == art::RC::SUCCESS,
+                it != kvs.end());
+      if (it != kvs.end()) {
+        EXPECT_EQ(val, it->second);
+        kvs.erase(it);
+      }
+      break;
+    }
+    case 1: {
+      // reads see buffered writes
+      auto it = kvs.find(key);
+      EXPECT_EQ(tree.search(key.c_str(), val) == art::RC::SUCCESS,
+                it != kvs.end());
+      if (it != kvs.end()) {
+        EXPECT_EQ(val, it->second);
+      }
+      break;
+    }
+    default:
+      tree.insert(key.c_str(), i);
+      kvs[key] = i;
+    }
+    EXPECT_LT(tree.buffered(), 64u);
+  }
+
+  auto iter = tree.tree().begin();
+  EXPECT_EQ(tree.buffered(), 0u);
+  for (auto &[k, v] : kvs) {
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    EXPECT_EQ(iter.getValue(), v);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+}
+
+TEST(TreeTest, AppendTest) {
+  art::AdaptiveRadixTree<TestInt> tree;
+  std::map<std::string, int> kvs;
+  int val = 0;
+
+  // decimal sequence numbers and wide byte counters
+  for (int i = 0; i < 20000; ++i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "log-%08d", i);
+    tree.append(buf, i);
+    kvs[buf] = i;
+  }
+  // appends keep copying paths shared with a live snapshot
+  art::AdaptiveRadixTree<TestInt> version;
+  for (int i = 0; i < 40000; ++i) {
+    std::string key = "seq-";
+    key += static_cast<char>(1 + i / 255 / 255 % 255);
+    key += static_cast<char>(1 + i / 255 % 255);
+    key += static_cast<char>(1 + i % 255);
+    tree.append(key.c_str(), i);
+    kvs[key] = i;
+    // other writes in between drop the cached path
+    if (i % 1000 == 0) {
+      std::string other = "other-" + std::to_string(i);
+      tree.insert(other.c_str(), -i);
+      kvs[other] = -i;
+    }
+    if (i % 1500 == 0) {
+      EXPECT_EQ(tree.remove(key.c_str(), val), art::RC::SUCCESS);
+      kvs.erase(key);
+    }
+    if (i % 3000 == 0) {
+      version = tree.snapshot();
+    }
+  }
+  // out of order appends still land in the right place
+  tree.append("log-00000005", -5);
+  kvs["log-00000005"] = -5;
+  tree.append("a", 1);
+  kvs["a"] = 1;
+
+  auto iter = tree.begin();
+  for (auto &[k, v] : kvs) {
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    EXPECT_EQ(iter.getValue(), v);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+#ifdef TEST_COUNTED
+  EXPECT_EQ(tree.size(), kvs.size());
+#endif
+}
+
+TEST(TreeTest, LazyRemoveTest) {
+  art::AdaptiveRadixTree<TestInt> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    if (++i % 4 == 0) {
+      tree.insert(line.c_str(), i);
+      kvs[line] = i;
+    }
+  }
+  auto expectSame = [&]() {
+    auto iter = tree.begin();
+    for (auto &[k, v] : kvs) {
+      ASSERT_TRUE(iter.valid());
+      EXPECT_EQ(std::string(iter.getKey()), k);
+      iter.next();
+    }
+    EXPECT_FALSE(iter.valid());
+#ifdef TEST_COUNTED
+    EXPECT_EQ(tree.size(), kvs.size());
+#endif
+  };
+
+  tree.setLazyRemove(true);
+  auto version = tree.snapshot();
+  auto versionKvs = kvs;
+  std::vector<std::string> removed;
+  int val = 0;
+  i = 0;
+  for (auto it = kvs.begin(); it != kvs.end(); ++i) {
+    if (i % 3 == 0) {
+      EXPECT_EQ(tree.remove(it->first.c_str(), val), art::RC::SUCCESS);
+      EXPECT_EQ(val, it->second);
+      EXPECT_EQ(tree.remove(it->first.c_str(), val), art::RC::KEY_NOT_EXIST);
+      EXPECT_EQ(tree.search(it->first.c_str(), val), art::RC::KEY_NOT_EXIST);
+      removed.push_back(it->first);
+      it = kvs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  expectSame();
+
+  // tombstones are skipped by cursors, traversal and prefix matches
+  auto cursor = tree.cursor();
+  for (size_t j = 0; j < removed.size(); j += 97) {
+    auto it = kvs.lower_bound(removed[j]);
+    EXPECT_FALSE(cursor.seek(removed[j].c_str()));
+    ASSERT_EQ(cursor.valid(), it != kvs.end());
+    if (it != kvs.end()) {
+      EXPECT_EQ(std::string(cursor.getKey()), it->first);
+    }
+    std::string longer = removed[j] + "\x01";
+    if (tree.longestPrefixMatch(longer.c_str(), val) == art::RC::SUCCESS) {
+      EXPECT_NE(val, versionKvs[removed[j]]);
+    }
+  }
+  size_t visited = 0;
+  tree.traverse(art::GlobAutomaton{"*"},
+                [&](const char *, const int &) { visited++; });
+  EXPECT_EQ(visited, kvs.size());
+
+  // removed keys come back on insert
+  bool added = false;
+  for (size_t j = 0; j < removed.size(); j += 2) {
+    tree.insert(removed[j].c_str(), -1, added);
+    EXPECT_TRUE(added);
+    kvs[removed[j]] = -1;
+  }
+  tree.insert(removed[0].c_str(), -1, added);
+  EXPECT_FALSE(added);
+  expectSame();
+
+  EXPECT_EQ(tree.purge(), removed.size() / 2);
+  EXPECT_EQ(tree.purge(), 0u);
+  expectSame();
+
+  // purge on its own every 100 lazy removes
+  tree.setLazyRemove(true, 100);
+  for (size_t j = 0; j < removed.size(); j += 2) {
+    EXPECT_EQ(tree.remove(removed[j].c_str(), val), art::RC::SUCCESS);
+    kvs.erase(removed[j]);
+  }
+  EXPECT_LT(tree.purge(), 100u);
+  expectSame();
+
+  // revived and unlinked tombstones no longer count to the threshold
+  std::vector<std::string> keys;
+  for (auto it = kvs.begin(); keys.size() < 12; ++it) {
+    keys.push_back(it->first);
+  }
+  tree.setLazyRemove(true, 12);
+  for (int j = 0; j < 5; ++j) {
+    EXPECT_EQ(tree.remove(keys[j].c_str(), val), art::RC::SUCCESS);
+    tree.insert(keys[j].c_str(), kvs[keys[j]]);
+  }
+  for (int j = 0; j < 5; ++j) {
+    EXPECT_EQ(tree.remove(keys[j].c_str(), val), art::RC::SUCCESS);
+  }
+  tree.setLazyRemove(false);
+  for (int j = 0; j < 5; ++j) {
+    EXPECT_EQ(tree.remove(keys[j].c_str(), val), art::RC::KEY_NOT_EXIST);
+    kvs.erase(keys[j]);
+  }
+  tree.setLazyRemove(true, 12);
+  for (int j = 5; j < 12; ++j) {
+    EXPECT_EQ(tree.remove(keys[j].c_str(), val), art::RC::SUCCESS);
+    kvs.erase(keys[j]);
+  }
+  EXPECT_EQ(tree.purge(), 7u);
+  expectSame();
+
+  // the snapshot kept every key
+  auto iter = version.begin();
+  for (auto &[k, v] : versionKvs) {
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(std::string(iter.getKey()), k);
+    EXPECT_EQ(iter.getValue(), v);
+    iter.next();
+  }
+  EXPECT_FALSE(iter.valid());
+}
+
+TEST(TreeTest, NodePolicyTest) {
+  // the printed tree of the final state
+  auto churn = [](auto &tree) {
+    std::map<std::string, int> kvs;
+    std::mt19937 gen(7);
+    // second bytes over a varying width keep nodes of every size
+    // moving up and down
+    std::uniform_int_distribution<int> byte(1, 255);
+    std::uniform_int_distribution<int> width(1, 4);
+    int val = 0;
+    for (int i = 0; i < 60000; ++i) {
+      std::string key = "k";
+      key += static_cast<char>(byte(gen) % (width(gen) * 63) + 1);
+      key += static_cast<char>(byte(gen));
+      if (i % 3 == 0) {
+        EXPECT_EQ(tree.remove(key.c_str(), val) == art::RC::SUCCESS,
+                  kvs.erase(key) == 1);
+      } else {
+        tree.insert(key.c_str(), i);
+        kvs[key] = i;
+      }
+      if (i % 10000 == 0) {
+        // a snapshot keeps its nodes while the tree changes them
+        auto version = tree.snapshot();
+        tree.eraseRange("k\x10", "k\x30");
+        kvs.erase(kvs.lower_bound("k\x10"), kvs.lower_bound("k\x30"));
+        // detach a subtree and merge it back
+        auto sub = tree.extractPrefix("k\x05");
+        tree.merge(std::move(sub), [](const char *, int a, int) { return a; });
+      }
+    }
+    // nodes of 6 and 20 children
+    for (int i = 0; i < 26; ++i) {
+      std::string key = std::string{i < 6 ? "n" : "w"} + char('a' + i);
+      tree.insert(key.c_str(), i);
+      kvs[key] = i;
+    }
+    for (auto &[k, v] : kvs) {
+      EXPECT_EQ(tree.search(k.c_str(), val), art::RC::SUCCESS);
+      EXPECT_EQ(val, v);
+    }
+    auto iter = tree.begin();
+    for (auto &[k, v] : kvs) {
+      EXPECT_TRUE(iter.valid());
+      EXPECT_EQ(std::string(iter.getKey()), k);
+      iter.next();
+    }
+    EXPECT_FALSE(iter.valid());
+#ifdef TEST_COUNTED
+    EXPECT_EQ(tree.size(), kvs.size());
+#endif
+    std::ostringstream oss;
+    art::AdaptiveRadixTreePrinter<TestInt> printer;
+    printer.draw(&tree, oss);
+    return oss.str();
+  };
+
+  art::AdaptiveRadixTree<TestInt> tree;
+  art::AdaptiveRadixTree<TestInt, art::HysteresisNodePolicy> hysteresis;
+  art::AdaptiveRadixTree<TestInt, art::FineNodePolicy> fine;
+  churn(tree);
+  churn(hysteresis);
+  std::string drawn = churn(fine);
+  EXPECT_NE(drawn.find("Node8 "), std::string::npos);
+  EXPECT_NE(drawn.find("Node32 "), std::string::npos);
+}
+
+TEST(TreeTest, CacheTest) {
+  art::AdaptiveRadixTree<int> tree;
+  constexpr size_t budget = 512 * 1024;
+  tree.setMemoryBudget(budget);
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  std::vector<std::string> hot;
+  int val = 0;
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    tree.insert(line.c_str(), i);
+    ASSERT_LE(tree.memoryUsage(), budget);
+    if (i < 200 && i % 2 == 0) {
+      hot.push_back(line);
+    }
+    // keep the hot keys referenced
+    if (i % 500 == 0) {
+      for (auto &key : hot) {
+        EXPECT_EQ(tree.search(key.c_str(), val), art::RC::SUCCESS);
+      }
+    }
+    // the tracked bytes match a count of the whole tree
+    if (i % 20000 == 0) {
+      EXPECT_EQ(tree.snapshot().memoryUsage(), tree.memoryUsage());
+    }
+    i++;
+  }
+  for (auto &key : hot) {
+    EXPECT_EQ(tree.search(key.c_str(), val), art::RC::SUCCESS);
+  }
+  size_t kept = 0;
+  for (auto iter = tree.begin(); iter.valid(); iter.next()) {
+    kept++;
+  }
+  EXPECT_GT(kept, hot.size());
+  EXPECT_LT(kept, static_cast<size_t>(i) / 10);
+
+  // bulk changes are recounted
+  tree.eraseRange("a", "m");
+  EXPECT_EQ(tree.snapshot().memoryUsage(), tree.memoryUsage());
+  // a smaller budget evicts right away
+  tree.setMemoryBudget(budget / 4);
+  EXPECT_LE(tree.memoryUsage(), budget / 4);
+  // unbounded again
+  size_t usage = tree.memoryUsage();
+  tree.setMemoryBudget(0);
+  tree.insert("unbounded", 1);
+  EXPECT_GT(tree.memoryUsage(), usage);
+}
+
+TEST(TreeTest, LazyRemoveBudgetTest) {
+  art::AdaptiveRadixTree<int> tree;
+  tree.setLazyRemove(true);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    tree.insert(keys.back().c_str(), i);
+  }
+  int val = 0;
+  for (auto &key : keys) {
+    EXPECT_EQ(tree.remove(key.c_str(), val), art::RC::SUCCESS);
+  }
+  // tombstones alone over the budget are dropped, not swept forever
+  tree.setMemoryBudget(1000);
+  EXPECT_LE(tree.memoryUsage(), 1000U);
+  EXPECT_FALSE(tree.begin().valid());
+
+  // tombstones go before any live entry is evicted
+  tree.setMemoryBudget(0);
+  for (int i = 0; i < 500; ++i) {
+    tree.insert(keys[i].c_str(), i);
+  }
+  size_t budget = tree.memoryUsage() * 11 / 10;
+  tree.setMemoryBudget(budget);
+  for (int i = 0; i < 400; ++i) {
+    EXPECT_EQ(tree.remove(keys[i].c_str(), val), art::RC::SUCCESS);
+  }
+  for (int i = 500; i < 900; ++i) {
+    tree.insert(keys[i].c_str(), i);
+    ASSERT_LE(tree.memoryUsage(), budget);
+  }
+  for (int i = 400; i < 900; ++i) {
+    EXPECT_EQ(tree.search(keys[i].c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, i);
+  }
+  EXPECT_EQ(tree.snapshot().memoryUsage(), tree.memoryUsage());
+}
+
+#ifdef ART_STATS
+TEST(TreeTest, StatsTest) {
+  art::AdaptiveRadixTree<int> tree;
+  art::resetStats();
+  for (auto key : {"a", "b", "c", "d", "e"}) {
+    tree.insert(key, 1);
+  }
+  int val = 0;
+  for (auto key : {"a", "b", "c", "d", "e"}) {
+    tree.search(key, val);
+  }
+  tree.remove("a", val);
+  // counted on another thread, kept after it exits
+  std::thread reader{[&tree]() {
+    int val = 0;
+    tree.search("b", val);
+  }};
+  reader.join();
+
+  art::Stats stats = art::collectStats();
+  EXPECT_EQ(stats.get(art::Counter::INSERTS), 5);
+  EXPECT_EQ(stats.get(art::Counter::LEAF_ALLOCS), 5);
+  EXPECT_EQ(stats.get(art::Counter::PREFIX_SPLITS), 1);
+  EXPECT_EQ(stats.get(art::Counter::SEARCHES), 6);
+  EXPECT_EQ(stats.get(art::Counter::SEARCH_NODES), 12);
+  EXPECT_EQ(stats.get(art::Counter::REMOVES), 1);
+  // the reader searched the Node4 left by the remove
+  EXPECT_EQ(stats.get(art::Counter::NODE16_SIMD) +
+                stats.get(art::Counter::NODE16_SCALAR),
+            6);
+  EXPECT_GT(stats.get(art::Counter::KEY_MATCH_BYTES), 0);
+  EXPECT_EQ(stats.get(art::growCounter(art::NodeType::Node4)), 1);
+  EXPECT_EQ(stats.get(art::shrinkCounter(art::NodeType::Node16)), 1);
+
+  std::map<std::string, uint64_t> exported;
+  art::setStatsExportHook([&exported](const std::string &name,
+                                      uint64_t value) {
+    exported[name] = value;
+  });
+  art::exportStats();
+  art::setStatsExportHook(nullptr);
+  EXPECT_EQ(exported.size(), static_cast<size_t>(art::Counter::COUNT));
+  EXPECT_EQ(exported["search.count"], 6);
+  EXPECT_EQ(exported["grow.node4"], 1);
+  EXPECT_EQ(exported["shrink.node16"], 1);
+
+  art::resetStats();
+  EXPECT_EQ(art::collectStats().get(art::Counter::SEARCHES), 0);
+}
+
+TEST(TreeTest, AppendGrowStatsTest) {
+  art::AdaptiveRadixTree<int> tree;
+  art::AdaptiveRadixTree<int, art::FineNodePolicy> fine;
+  art::resetStats();
+  for (int i = 0; i < 200; ++i) {
+    std::string key{'k', static_cast<char>(32 + i)};
+    tree.append(key.c_str(), i);
+    fine.append(key.c_str(), i);
+  }
+  // the full Node16 went straight to Node256 in both trees
+  art::Stats stats = art::collectStats();
+  EXPECT_EQ(stats.get(art::growCounter(art::NodeType::Node16)), 2);
+  EXPECT_EQ(stats.get(art::growCounter(art::NodeType::Node32)), 0);
+  EXPECT_EQ(stats.get(art::growCounter(art::NodeType::Node48)), 0);
+  int val = 0;
+  EXPECT_EQ(tree.search("k\x7f", val), art::RC::SUCCESS);
+  EXPECT_EQ(val, 95);
+  EXPECT_EQ(fine.search("k\x7f", val), art::RC::SUCCESS);
+}
+#endif
+
+TEST(TreeTest, CompareTest) {
+  std::mt19937 gen(11);
+  // exactly sized heap buffers let ASan catch reads past either end
+  for (int n = 0; n <= 100; ++n) {
+    for (int diff = 0; diff <= n; ++diff) {
+      auto a = std::make_unique<char[]>(n);
+      auto b = std::make_unique<char[]>(n);
+      for (int i = 0; i < n; ++i) {
+        a[i] = b[i] = static_cast<char>(gen());
+      }
+      if (diff < n) {
+        b[diff] = static_cast<char>(a[diff] ^ (1 << (gen() % 8)));
+      }
+      ASSERT_EQ(art::mismatch(a.get(), b.get(), n), diff);
+    }
+  }
+
+  // long keys that differ late, early and only in their length
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+  std::uniform_int_distribution<int> len(40, 200);
+  std::uniform_int_distribution<int> byte('a', 'd');
+  for (int i = 0; i < 5000; ++i) {
+    std::string key(len(gen), 'x');
+    for (int j = key.size() - 8; j < static_cast<int>(key.size()); ++j) {
+      key[j] = static_cast<char>(byte(gen));
+    }
+    if (i % 3 == 0) {
+      key[gen() % key.size()] = static_cast<char>(byte(gen));
+    }
+    tree.insert(key.c_str(), i);
+    kvs[key] = i;
+  }
+  int val = 0;
+  for (auto &[key, value] : kvs) {
+    ASSERT_EQ(tree.search(key.c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, value);
+    std::string longer = key + "x";
+    if (kvs.count(longer) == 0) {
+      EXPECT_EQ(tree.search(longer.c_str(), val), art::RC::KEY_NOT_EXIST);
+    }
+    std::string shorter = key.substr(0, key.size() - 1);
+    if (kvs.count(shorter) == 0) {
+      EXPECT_EQ(tree.search(shorter.c_str(), val), art::RC::KEY_NOT_EXIST);
+    }
+  }
+  int i = 0;
+  for (auto &[key, value] : kvs) {
+    if (++i % 2 == 0) {
+      ASSERT_EQ(tree.remove(key.c_str(), val), art::RC::SUCCESS);
+      EXPECT_EQ(val, value);
+      EXPECT_EQ(tree.search(key.c_str(), val), art::RC::KEY_NOT_EXIST);
+    }
+  }
+  i = 0;
+  for (auto &[key, value] : kvs) {
+    EXPECT_EQ(tree.search(key.c_str(), val) == art::RC::SUCCESS, ++i % 2 == 1);
+  }
+}
+
+TEST(TreeTest, ValueLogTest) {
+  art::LoggedAdaptiveRadixTree<std::string> tree;
+  std::map<std::string, std::string> kvs;
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> size(512, 4096);
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  std::vector<std::string> keys;
+  while (std::getline(infile, line) && keys.size() < 5000) {
+    keys.push_back(line.substr(1, line.size() - 3));
+  }
+  std::string val;
+  size_t maxLog = 0;
+  for (int round = 0; round < 4; ++round) {
+    for (auto &key : keys) {
+      if (gen() % 4 == 0) {
+        EXPECT_EQ(tree.remove(key.c_str(), val) == art::RC::SUCCESS,
+                  kvs.erase(key) == 1);
+        continue;
+      }
+      std::string value(size(gen), static_cast<char>('a' + round));
+      tree.insert(key.c_str(), value);
+      kvs[key] = value;
+    }
+    maxLog = std::max(maxLog, tree.log().size());
+  }
+  // updates and removes were compacted away on the way
+  EXPECT_LT(maxLog, 2 * keys.size());
+  EXPECT_EQ(tree.log().live(), kvs.size());
+  for (auto &[key, value] : kvs) {
+    const std::string *found = tree.view(key.c_str());
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, value);
+  }
+
+  tree.compact();
+  EXPECT_EQ(tree.log().garbage(), 0);
+  EXPECT_EQ(tree.log().size(), kvs.size());
+  for (auto &key : keys) {
+    auto it = kvs.find(key);
+    if (it == kvs.end()) {
+      EXPECT_EQ(tree.search(key.c_str(), val), art::RC::KEY_NOT_EXIST);
+    } else {
+      ASSERT_EQ(tree.search(key.c_str(), val), art::RC::SUCCESS);
+      EXPECT_EQ(val, it->second);
+    }
+  }
+}
+
+TEST(TreeTest, NodeMemoryTest) {
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  std::vector<std::string> keys;
+  while (std::getline(infile, line)) {
+    keys.push_back(line.substr(1, line.size() - 3));
+  }
+  // nodes of the heap and of the arenas are mixed in one tree
+  art::AdaptiveRadixTree<int> tree;
+  for (size_t i = 0; i < keys.size() / 2; ++i) {
+    tree.insert(keys[i].c_str(), i);
+  }
+  art::NodeMemoryOptions options;
+  options.numaLocal = true;
+  options.interleaveUpper = true;
+  options.reserve = size_t{64} << 20;
+  art::useNodeMemory(options);
+  for (size_t i = keys.size() / 2; i < keys.size(); ++i) {
+    tree.insert(keys[i].c_str(), i);
+  }
+  int val = 0;
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    ASSERT_EQ(tree.remove(keys[i].c_str(), val), art::RC::SUCCESS);
+  }
+  // freed blocks are reused
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    tree.insert(keys[i].c_str(), i);
+  }
+  art::useDefaultNodeMemory();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(tree.search(keys[i].c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, i);
+  }
+  auto snap = tree.snapshot();
+  for (size_t i = 1; i < keys.size(); i += 2) {
+    ASSERT_EQ(tree.remove(keys[i].c_str(), val), art::RC::SUCCESS);
+  }
+  EXPECT_EQ(snap.search(keys[1].c_str(), val), art::RC::SUCCESS);
+}
+
+TEST(TreeTest, CompactTest) {
+  art::AdaptiveRadixTree<TestInt> tree;
+  std::map<std::string, int> kvs;
+  std::mt19937 gen(17);
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  std::vector<std::string> keys;
+  while (std::getline(infile, line)) {
+    keys.push_back(line.substr(1, line.size() - 3));
+  }
+  int val = 0;
+  // leave the nodes scattered by churn
+  for (int i = 0; i < 200000; ++i) {
+    auto &key = keys[gen() % keys.size()];
+    if (gen() % 3 == 0) {
+      tree.remove(key.c_str(), val);
+      kvs.erase(key);
+    } else {
+      tree.insert(key.c_str(), i);
+      kvs[key] = i;
+    }
+  }
+  auto check = [&]() {
+    auto it = tree.begin();
+    for (auto &[key, value] : kvs) {
+      ASSERT_TRUE(it.valid());
+      EXPECT_EQ(it.getKey(), key);
+      EXPECT_EQ(it.getValue(), value);
+      it.next();
+    }
+    EXPECT_FALSE(it.valid());
+#ifdef TEST_COUNTED
+    EXPECT_EQ(tree.size(), kvs.size());
+#endif
+  };
+
+  // the default heap doesn't place the nodes in order
+  EXPECT_EQ(tree.compact(), art::RC::NO_NODE_MEMORY);
+  art::NodeMemoryOptions options;
+  options.reserve = size_t{256} << 20;
+  art::useNodeMemory(options);
+  size_t usage = tree.memoryUsage();
+  EXPECT_EQ(tree.compact(), art::RC::SUCCESS);
+  EXPECT_EQ(tree.memoryUsage(), usage);
+  check();
+
+  // a few subtrees per call, with writes in between
+  int calls = 0;
+  while (tree.compact(std::chrono::microseconds{1}) ==
+         art::RC::IN_PROGRESS) {
+    calls++;
+    auto &key = keys[gen() % keys.size()];
+    if (gen() % 2 == 0) {
+      tree.remove(key.c_str(), val);
+      kvs.erase(key);
+    } else {
+      tree.insert(key.c_str(), calls);
+      kvs[key] = calls;
+    }
+  }
+  EXPECT_GT(calls, 1);
+  check();
+
+  // nodes shared with a snapshot stay, both versions are intact
+  auto snap = tree.snapshot();
+  std::map<std::string, int> before = kvs;
+  tree.insert("compact", 1);
+  kvs["compact"] = 1;
+  EXPECT_EQ(tree.compact(), art::RC::SUCCESS);
+  check();
+  EXPECT_EQ(snap.search("compact", val), art::RC::KEY_NOT_EXIST);
+  for (auto &[key, value] : before) {
+    ASSERT_EQ(snap.search(key.c_str(), val), art::RC::SUCCESS);
+    EXPECT_EQ(val, value);
+  }
+
+  // the searched keys come first
+  tree.setMemoryBudget(size_t{1} << 30);
+  for (size_t i = 0; i < keys.size(); i += 7) {
+    tree.search(keys[i].c_str(), val);
+  }
+  EXPECT_EQ(tree.compact({}, art::CompactOrder::HOT_FIRST), art::RC::SUCCESS);
+  check();
+  art::useDefaultNodeMemory();
+}
+
+TEST(TreeTest, LayoutTest) {
+  // inner nodes start on a cache line, from the heap and from arenas
+  auto aligned = []() {
+    std::vector<std::unique_ptr<art::Node<int>>> nodes;
+    nodes.emplace_back(new art::Node4<int>());
+    nodes.emplace_back(new art::Node8<int>());
+    nodes.emplace_back(new art::Node16<int>());
+    nodes.emplace_back(new art::Node32<int>());
+    nodes.emplace_back(new art::Node48<int>());
+    nodes.emplace_back(new art::Node256<int>());
+    for (auto &node : nodes) {
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(node.get()) % art::CACHE_LINE, 0);
+    }
+  };
+  aligned();
+  art::NodeMemoryOptions options;
+  options.reserve = size_t{16} << 20;
+  art::useNodeMemory(options);
+  // a leaf first leaves the arena off a line boundary
+  delete new art::LeafNode<int>("a", 1);
+  aligned();
+
+  art::AdaptiveRadixTree<int> tree;
+  EXPECT_EQ(tree.cacheLines("a"), 0);
+  tree.insert("ab", 1);
+  tree.insert("ac", 2);
+  // the node fills its own line, the leaf and the prefixes may share
+  // lines with each other and a leaf may straddle two
+  EXPECT_GE(tree.cacheLines("ab"), 2);
+  EXPECT_LE(tree.cacheLines("ab"), 6);
+  // the node only, the byte is not there
+  EXPECT_LE(tree.cacheLines("ad"), 2);
+  art::useDefaultNodeMemory();
+}
+
+TEST(TreeTest, ParallelTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    tree.insert(line.c_str(), ++i);
+    kvs[line] = i;
+  }
+  // tombstones are skipped like by the iterator
+  tree.setLazyRemove(true);
+  int val = 0;
+  for (auto it = kvs.begin(); it != kvs.end();) {
+    if (it->second % 5 == 0) {
+      tree.remove(it->first.c_str(), val);
+      it = kvs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (unsigned threads : {1U, 4U, 0U}) {
+    std::mutex mutex;
+    std::map<std::string, int> seen;
+    tree.parallelForEach(
+        [&](const char *key, int value) {
+          std::lock_guard<std::mutex> lock{mutex};
+          EXPECT_TRUE(seen.emplace(key, value).second);
+        },
+        threads);
+    EXPECT_EQ(seen, kvs);
+  }
+
+  auto collect = [&](const char *lo, const char *hi) {
+    return tree.parallelCollect<std::vector<std::string>>(
+        lo, hi,
+        [](std::vector<std::string> &out, const char *key, int) {
+          out.emplace_back(key);
+        },
+        8);
+  };
+  auto expected = [&](const char *lo, const char *hi) {
+    std::vector<std::string> keys;
+    for (auto &[key, value] : kvs) {
+      if ((lo == nullptr || key >= lo) && (hi == nullptr || key < hi)) {
+        keys.push_back(key);
+      }
+    }
+    return keys;
+  };
+  // the bounds themselves, keys they prefix and gaps between keys
+  const char *bounds[][2] = {{nullptr, nullptr}, {"b", "c"},
+                             {"car", "cars"},    {"ca", nullptr},
+                             {nullptr, "m"},     {"", "zz"},
+                             {"mid", "mie"},     {"q", "p"}};
+  for (auto &[lo, hi] : bounds) {
+    EXPECT_EQ(collect(lo, hi), expected(lo, hi));
+  }
+  std::atomic<size_t> count{0};
+  tree.parallelScan(
+      "d", "e", [&](const char *key, int) { count += key[0] == 'd'; }, 3);
+  EXPECT_EQ(count, expected("d", "e").size());
+
+  // an exception stops the scan and is rethrown
+  EXPECT_THROW(tree.parallelForEach(
+                   [](const char *, int) { throw std::runtime_error("stop"); },
+                   4),
+               std::runtime_error);
+  art::AdaptiveRadixTree<int> empty;
+  empty.parallelForEach([](const char *, int) { FAIL(); });
+}
+
+TEST(TreeTest, MergeIteratorTest) {
+  // a base, a sparse delta and a delta of only new keys
+  art::AdaptiveRadixTree<int> base, delta, added;
+  std::map<std::string, std::pair<int, size_t>> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  int i = 0;
+  while (std::getline(infile, line)) {
+    line = line.substr(1, line.size() - 3);
+    base.insert(line.c_str(), ++i);
+    kvs[line] = {i, 2};
+  }
+  for (auto it = kvs.begin(); it != kvs.end(); std::advance(it, 97)) {
+    delta.insert(it->first.c_str(), -it->second.first);
+    it->second = {-it->second.first, 1};
+    if (std::distance(it, kvs.end()) < 97) {
+      break;
+    }
+  }
+  for (const char *key : {"aaaa-new", "m-new", "zzzz-new", "car-new"}) {
+    added.insert(key, 7);
+    kvs[key] = {7, 0};
+  }
+  // updates in delta and new keys in added win over base
+  auto check = [&](art::MergeIterator<int> &it,
+                   std::map<std::string, std::pair<int, size_t>>::iterator
+                       first) {
+    for (; first != kvs.end(); ++first) {
+      ASSERT_TRUE(it.valid());
+      EXPECT_EQ(it.getKey(), first->first);
+      EXPECT_EQ(it.getValue(), first->second.first);
+      EXPECT_EQ(it.source(), first->second.second);
+      it.next();
+    }
+    EXPECT_FALSE(it.valid());
+  };
+  auto it = art::mergeIterator(added, delta, base);
+  check(it, kvs.begin());
+
+  // forward seeks skip subtrees, backward seeks start over
+  for (const char *key : {"m", "car", "car-new", "zzzz-new", "a", "zzzzz"}) {
+    auto first = kvs.lower_bound(key);
+    EXPECT_EQ(it.seek(key), first != kvs.end() && first->first == key);
+    check(it, first);
+  }
+  it.seek("m");
+  it.seek("n");
+  check(it, kvs.lower_bound("n"));
+
+  art::AdaptiveRadixTree<int> empty;
+  auto none = art::mergeIterator(empty, empty);
+  EXPECT_FALSE(none.valid());
+}
+
+TEST(TreeTest, ColumnsTest) {
+  art::AdaptiveRadixTree<int> tree;
+  std::map<std::string, int> kvs;
+
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  std::vector<std::string> words;
+  int i = 0;
+  while (std::getline(infile, line)) {
+    words.push_back(line.substr(1, line.size() - 3));
+    tree.insert(words.back().c_str(), ++i);
+    kvs[words.back()] = i;
+  }
+  // tombstones are not exported
+  tree.setLazyRemove(true);
+  int val = 0;
+  for (size_t j = 0; j < words.size(); j += 3) {
+    tree.remove(words[j].c_str(), val);
+    kvs.erase(words[j]);
+  }
+
+  auto sizes = art::columnSizes(tree);
+  EXPECT_EQ(sizes.keys, kvs.size());
+  auto columns = art::exportColumns<uint32_t>(tree);
+  ASSERT_EQ(columns.size(), kvs.size());
+  EXPECT_EQ(columns.keys.size(), sizes.keyBytes);
+  EXPECT_EQ(columns.offsets.back(), sizes.keyBytes);
+  size_t j = 0;
+  for (auto &[key, value] : kvs) {
+    EXPECT_EQ(columns.key(j), key);
+    EXPECT_EQ(columns.values[j], value);
+    j++;
+  }
+
+  // buffers too small for the tree are not overrun
+  std::vector<char> keys(sizes.keyBytes);
+  std::vector<uint64_t> offsets(sizes.keys + 1);
+  std::vector<int> values(sizes.keys);
+  EXPECT_EQ(art::exportColumns(tree, sizes, keys.data(), offsets.data(),
+                               values.data()),
+            art::RC::SUCCESS);
+  EXPECT_EQ(keys, columns.keys);
+  art::ColumnSizes small = sizes;
+  small.keyBytes--;
+  EXPECT_EQ(art::exportColumns(tree, small, keys.data(), offsets.data(),
+                               values.data()),
+            art::RC::INTERNAL_FAILURE);
+  small = sizes;
+  small.keys--;
+  EXPECT_EQ(art::exportColumns(tree, small, keys.data(), offsets.data(),
+                               values.data()),
+            art::RC::INTERNAL_FAILURE);
+
+  // sort a shuffled batch with duplicates
+  std::vector<std::string> batch(words.begin(), words.begin() + 1000);
+  batch.insert(batch.end(), words.begin(), words.begin() + 10);
+  std::shuffle(batch.begin(), batch.end(), std::mt19937{5});
+  auto sorted = art::radixSort(batch.begin(), batch.end());
+  std::set<std::string> expected(batch.begin(), batch.end());
+  ASSERT_EQ(sorted.size(), expected.size());
+  j = 0;
+  for (auto &key : expected) {
+    EXPECT_EQ(sorted.key(j), key);
+    EXPECT_EQ(batch[sorted.values[j]], key);
+    j++;
+  }
+  std::vector<const char *> raw{"b", "a", "ab", ""};
+  auto small32 = art::radixSort<uint32_t>(raw.begin(), raw.end());
+  ASSERT_EQ(small32.size(), 4);
+  EXPECT_EQ(small32.key(0), "");
+  EXPECT_EQ(small32.key(3), "b");
+}
+
+TEST(TreeTest, PartitionedTest) {
+  std::ifstream infile{"./words.txt"};
+  std::string line;
+  ASSERT_TRUE(infile);
+  std::vector<std::string> keys;
+  while (std::getline(infile, line)) {
+    keys.push_back(line.substr(1, line.size() - 3));
+  }
+  art::PartitionOptions options;
+  // rebalanced by hand below and by the monitor meanwhile
+  options.rebalanceInterval = std::chrono::milliseconds{1};
+  options.minKeys = 256;
+  options.ringCapacity = 64;
+  std::map<std::string, int> kvs;
+  std::atomic<int> calls{0};
+  {
+    art::PartitionedAdaptiveRadixTree<int> tree{4, options};
+    ASSERT_EQ(tree.partitions(), 4);
+    // the words skew to the partitions of lowercase letters
+    std::vector<std::thread> writers;
+    for (size_t w = 0; w < 4; ++w) {
+      writers.emplace_back([&, w] {
+        std::vector<std::future<art::RC>> results;
+        for (size_t i = w; i < keys.size(); i += 4) {
+          results.push_back(tree.insert(keys[i].c_str(), i));
+        }
+        for (auto &result : results) {
+          EXPECT_EQ(result.get(), art::RC::SUCCESS);
+        }
+      });
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+      kvs[keys[i]] = i;
+    }
+    // removes and scans race with the rebalancing
+    for (int round = 0; round < 20; ++round) {
+      tree.rebalance();
+    }
+    for (auto &writer : writers) {
+      writer.join();
+    }
+    for (size_t i = 0; i < keys.size(); i += 3) {
+      auto [rc, value] = tree.remove(keys[i].c_str()).get();
+      if (kvs.erase(keys[i]) != 0) {
+        EXPECT_EQ(rc, art::RC::SUCCESS);
+        EXPECT_EQ(keys[value], keys[i]);
+      } else {
+        EXPECT_EQ(rc, art::RC::KEY_NOT_EXIST);
+      }
+      if (i % 3000 == 0) {
+        tree.rebalance();
+      }
+    }
+    EXPECT_EQ(tree.size(), kvs.size());
+    while (tree.rebalance()) {
+    }
+    auto sizes = tree.partitionSizes();
+    auto [small, large] = std::minmax_element(sizes.begin(), sizes.end());
+    EXPECT_LE(*large, *small * 3);
+
+    for (auto &[key, value] : kvs) {
+      auto [rc, found] = tree.search(key.c_str()).get();
+      ASSERT_EQ(rc, art::RC::SUCCESS);
+      EXPECT_EQ(found, value);
+    }
+    auto all = tree.scan(nullptr, nullptr).get();
+    ASSERT_EQ(all.size(), kvs.size());
+    EXPECT_TRUE(std::equal(all.begin(), all.end(), kvs.begin(),
+                           [](auto &a, auto &b) {
+                             return a.first == b.first && a.second == b.second;
+                           }));
+    auto some = tree.scan("car", "dog").get();
+    auto first = kvs.lower_bound("car"), last = kvs.lower_bound("dog");
+    ASSERT_EQ(some.size(), std::distance(first, last));
+    EXPECT_EQ(some.front().first, first->first);
+    EXPECT_TRUE(tree.scan("q", "p").get().empty());
+
+    // callbacks run on the workers, operations still pending are done
+    // before the destructor returns
+    for (int i = 0; i < 100; ++i) {
+      tree.insert(std::to_string(i).c_str(), i,
+                  [&calls](art::RC, const int &) { calls++; });
+    }
+    tree.search("0", [&calls](art::RC rc, const int &value) {
+      EXPECT_EQ(rc, art::RC::SUCCESS);
+      EXPECT_EQ(value, 0);
+      calls++;
+    });
+  }
+  EXPECT_EQ(calls, 101);
+}